@@ -0,0 +1,216 @@
+#include "behavior_cost.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const char *const kTermNames[kNumCostTerms] = {
+    "efficiency", "safety", "preference", "comfort", "route", "legality"};
+
+// One kernel per term, each a single pass over the candidates.
+
+void EfficiencyCost(int n, double speed_limit,
+                    const double *__restrict speed_ahead,
+                    double *__restrict cost) {
+  const double inv_limit = 1.0 / speed_limit;
+  for (int i = 0; i < n; i++) {
+    const double speed =
+        (speed_ahead[i] < speed_limit) ? speed_ahead[i] : speed_limit;
+    cost[i] = (speed_limit - speed) * inv_limit;
+  }
+}
+
+// The gap ahead always counts; the one behind only when changing lanes.
+void SafetyCost(int n, double safe_gap, const double *__restrict gap_ahead,
+                const double *__restrict gap_behind,
+                const double *__restrict lane_change,
+                double *__restrict cost) {
+  const double inv_gap = 1.0 / safe_gap;
+  for (int i = 0; i < n; i++) {
+    double ahead = 1.0 - gap_ahead[i] * inv_gap;
+    ahead = (ahead > 0) ? ahead : 0.0;
+    double behind = (1.0 - gap_behind[i] * inv_gap) * lane_change[i];
+    behind = (behind > 0) ? behind : 0.0;
+    cost[i] = (ahead > behind) ? ahead : behind;
+  }
+}
+
+void RouteCost(int n, double scale, const double *__restrict excess,
+               double *__restrict cost) {
+  const double inv_scale = 1.0 / scale;
+  for (int i = 0; i < n; i++) {
+    const double value = excess[i] * inv_scale;
+    cost[i] = (value < 1.0) ? value : 1.0;
+  }
+}
+
+void CopyCost(int n, const double *__restrict value, double *__restrict cost) {
+  for (int i = 0; i < n; i++) {
+    cost[i] = value[i];
+  }
+}
+
+void AddWeighted(int n, double weight, const double *__restrict cost,
+                 double *__restrict total) {
+  for (int i = 0; i < n; i++) {
+    total[i] += weight * cost[i];
+  }
+}
+
+}  // namespace
+
+void BehaviorCandidates::Clear() {
+  to.clear();
+  lane.clear();
+  lane_change.clear();
+  preference.clear();
+  illegal.clear();
+}
+
+void BehaviorCandidates::Add(int to_state, int target_lane, int lanes_moved,
+                             double cost, bool legal) {
+  to.push_back(to_state);
+  lane.push_back(target_lane);
+  lane_change.push_back(lanes_moved);
+  preference.push_back(cost);
+  illegal.push_back(legal ? 0.0 : 1.0);
+}
+
+void LaneTraffic::Resize(int num_lanes) {
+  gap_ahead.resize(num_lanes);
+  gap_behind.resize(num_lanes);
+  speed_ahead.resize(num_lanes);
+  route.resize(num_lanes);
+}
+
+BehaviorCostModel::BehaviorCostModel()
+    : speed_limit_(22.1), safe_gap_(30.0), route_scale_(1.0),
+      num_candidates_(0),
+      num_evaluations_(0) {
+  weights_[kCostEfficiency] = 0.2;
+  weights_[kCostSafety] = 0.2;
+  weights_[kCostPreference] = 1.0;
+  weights_[kCostComfort] = 0.0;
+  weights_[kCostRoute] = 0.2;
+  weights_[kCostLegality] = 1000.0;
+  for (int t = 0; t < kNumCostTerms; t++) {
+    term_ms_[t] = 0;
+  }
+}
+
+const char *BehaviorCostModel::TermName(BehaviorCostTerm term) {
+  return kTermNames[term];
+}
+
+bool BehaviorCostModel::Load(const std::string &path) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+
+  BehaviorCostModel loaded;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream iss(line);
+    std::string key;
+    if (!(iss >> key) || key[0] == '#') {
+      continue;
+    }
+    double value;
+    if (!(iss >> value)) {
+      return false;
+    }
+
+    bool known = false;
+    for (int t = 0; t < kNumCostTerms; t++) {
+      if (key == kTermNames[t]) {
+        loaded.weights_[t] = value;
+        known = true;
+      }
+    }
+    if (key == "speed_limit" && value > 0) {
+      loaded.speed_limit_ = value;
+      known = true;
+    } else if (key == "safe_gap" && value > 0) {
+      loaded.safe_gap_ = value;
+      known = true;
+    } else if (key == "route_scale" && value > 0) {
+      loaded.route_scale_ = value;
+      known = true;
+    }
+    if (!known) {
+      return false;
+    }
+  }
+  *this = loaded;
+  return true;
+}
+
+int BehaviorCostModel::Evaluate(const BehaviorCandidates &candidates,
+                                const LaneTraffic &traffic) {
+  const int n = candidates.size();
+  num_candidates_ = n;
+  num_evaluations_++;
+  if (n == 0) {
+    return -1;
+  }
+  gap_ahead_.resize(n);
+  gap_behind_.resize(n);
+  speed_ahead_.resize(n);
+  route_.resize(n);
+  for (int t = 0; t < kNumCostTerms; t++) {
+    values_[t].resize(n);
+  }
+  total_.assign(n, 0.0);
+
+  // Gather the traffic of each candidate's lane. Candidates off the road
+  // are illegal anyway; they read the nearest lane.
+  const int max_lane = traffic.num_lanes() - 1;
+  for (int i = 0; i < n; i++) {
+    int lane = candidates.lane[i];
+    lane = (lane < 0) ? 0 : (lane > max_lane ? max_lane : lane);
+    gap_ahead_[i] = traffic.gap_ahead[lane];
+    gap_behind_[i] = traffic.gap_behind[lane];
+    speed_ahead_[i] = traffic.speed_ahead[lane];
+    route_[i] = traffic.route[lane];
+  }
+
+  for (int t = 0; t < kNumCostTerms; t++) {
+    Clock::time_point start = Clock::now();
+    double *cost = values_[t].data();
+    switch (t) {
+      case kCostEfficiency:
+        EfficiencyCost(n, speed_limit_, speed_ahead_.data(), cost);
+        break;
+      case kCostSafety:
+        SafetyCost(n, safe_gap_, gap_ahead_.data(), gap_behind_.data(),
+                   candidates.lane_change.data(), cost);
+        break;
+      case kCostPreference:
+        CopyCost(n, candidates.preference.data(), cost);
+        break;
+      case kCostComfort:
+        CopyCost(n, candidates.lane_change.data(), cost);
+        break;
+      case kCostRoute:
+        RouteCost(n, route_scale_, route_.data(), cost);
+        break;
+      case kCostLegality:
+        CopyCost(n, candidates.illegal.data(), cost);
+        break;
+    }
+    AddWeighted(n, weights_[t], cost, total_.data());
+    term_ms_[t] += std::chrono::duration<double, std::milli>(
+                       Clock::now() - start).count();
+  }
+
+  int best = 0;
+  for (int i = 1; i < n; i++) {
+    best = (total_[i] < total_[best]) ? i : best;
+  }
+  return best;
+}
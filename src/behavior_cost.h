@@ -0,0 +1,96 @@
+#ifndef BEHAVIOR_COST_H_
+#define BEHAVIOR_COST_H_
+
+#include <string>
+#include <vector>
+
+// Terms the behavior decisions are scored with.
+enum BehaviorCostTerm {
+  kCostEfficiency,   // how far below the speed limit the target lane drives
+  kCostSafety,       // how short the gaps on the target lane are
+  kCostPreference,   // the cost of the transition in the state machine table
+  kCostComfort,      // lanes moved across
+  kCostRoute,        // how much worse the best lane sequence through the
+                     // target lane is than the best overall
+  kCostLegality,     // 1 if the transition's conditions do not hold
+  kNumCostTerms
+};
+
+// Candidate transitions of one tick, structure-of-arrays.
+struct BehaviorCandidates {
+  void Clear();
+  void Add(int to, int lane, int lane_change, double preference, bool legal);
+  int size() const { return static_cast<int>(to.size()); }
+
+  std::vector<int> to;               // target state
+  std::vector<int> lane;             // lane the target state is about
+  std::vector<double> lane_change;   // lanes moved across, 0 or 1
+  std::vector<double> preference;
+  std::vector<double> illegal;       // 0 or 1
+};
+
+// Traffic around the ego car on each lane.
+struct LaneTraffic {
+  void Resize(int num_lanes);
+  int num_lanes() const { return static_cast<int>(gap_ahead.size()); }
+
+  std::vector<double> gap_ahead;    // m to the closest car in front
+  std::vector<double> gap_behind;   // m to the closest car behind
+  std::vector<double> speed_ahead;  // m/s of the closest car in front
+  // Cost of the best lane sequence starting towards each lane minus the
+  // best of all; infinite for lanes out of reach.
+  std::vector<double> route;
+};
+
+// Weighted sum of independent cost terms, evaluated for all candidates of
+// a tick at once: each term is one loop over the candidate arrays. The
+// weights come from data/behavior_costs.txt so behavior can be tuned
+// without recompiling, and the value and time of every term are kept for
+// tracing.
+class BehaviorCostModel {
+ public:
+  // Starts with the parameters shipped in data/behavior_costs.txt.
+  BehaviorCostModel();
+
+  // Reads weights and parameters from a file; see data/behavior_costs.txt
+  // for the format. Returns false, keeping the current parameters, if the
+  // file cannot be read or has an unknown entry.
+  bool Load(const std::string &path);
+
+  // Scores the candidates against the traffic and returns the index of the
+  // cheapest; ties go to the earlier candidate. -1 if there are none.
+  int Evaluate(const BehaviorCandidates &candidates,
+               const LaneTraffic &traffic);
+
+  double weight(BehaviorCostTerm term) const { return weights_[term]; }
+  static const char *TermName(BehaviorCostTerm term);
+
+  // Traces of the last Evaluate() call: the unweighted value of each term
+  // and the weighted total per candidate.
+  int num_candidates() const { return num_candidates_; }
+  double term(BehaviorCostTerm term, int candidate) const {
+    return values_[term][candidate];
+  }
+  double total(int candidate) const { return total_[candidate]; }
+
+  // Time spent in each term over all Evaluate() calls.
+  long num_evaluations() const { return num_evaluations_; }
+  double term_ms(BehaviorCostTerm term) const { return term_ms_[term]; }
+
+ private:
+  double weights_[kNumCostTerms];
+  double speed_limit_;  // m/s
+  double safe_gap_;     // m; shorter gaps cost more
+  double route_scale_;  // route cost difference that costs 1
+
+  // Per-candidate inputs gathered from the lane traffic.
+  std::vector<double> gap_ahead_, gap_behind_, speed_ahead_, route_;
+  std::vector<double> values_[kNumCostTerms];
+  std::vector<double> total_;
+  int num_candidates_;
+
+  long num_evaluations_;
+  double term_ms_[kNumCostTerms];
+};
+
+#endif  // BEHAVIOR_COST_H_
@@ -0,0 +1,89 @@
+#include "behavior_fsm.h"
+
+namespace {
+
+constexpr BehaviorStateInfo kStates[kNumBehaviorStates] = {
+    {"keep lane", 0, 0, kSpeedUp},
+    {"prepare to change left", -1, 0, kMatchLead},
+    {"prepare to change right", +1, 0, kMatchLead},
+    {"change to left", -1, -1, kKeepSpeed},
+    {"change to right", +1, +1, kKeepSpeed},
+};
+
+// Rows are grouped by `from` and ordered by `to`. Left is preferred over
+// right when both are possible, and preparing states wait at 0.7 unless a
+// move is clearly better.
+constexpr BehaviorTransition kTransitions[] = {
+    // Keep lane: stay while nothing is close ahead, otherwise start
+    // preparing a lane change
+    {kStateKeepLane, kStateKeepLane, 0, kCarAhead, 0.0},
+    {kStateKeepLane, kStateKeepLane, kCarAhead, 0, 0.5},
+    {kStateKeepLane, kStatePrepareLeft, kLeftLane, 0, 0.3},
+    {kStateKeepLane, kStatePrepareRight, kRightLane, 0, 0.4},
+
+    // Prepare left: go back once the lane ahead is free, change when the
+    // left lane is clear, or try the right instead
+    {kStatePrepareLeft, kStateKeepLane, 0, kCarAhead, 0.0},
+    {kStatePrepareLeft, kStatePrepareLeft, 0, 0, 0.7},
+    {kStatePrepareLeft, kStatePrepareRight, kRightLane | kRightClear, 0, 0.5},
+    {kStatePrepareLeft, kStateChangeLeft, kLeftClear, 0, 0.0},
+
+    // Prepare right: the mirror image
+    {kStatePrepareRight, kStateKeepLane, 0, kCarAhead, 0.0},
+    {kStatePrepareRight, kStatePrepareLeft, kLeftLane | kLeftClear, 0, 0.5},
+    {kStatePrepareRight, kStatePrepareRight, 0, 0, 0.7},
+    {kStatePrepareRight, kStateChangeRight, kRightClear, 0, 0.0},
+
+    // The lane change itself takes one tick
+    {kStateChangeLeft, kStateKeepLane, 0, 0, 0.0},
+    {kStateChangeRight, kStateKeepLane, 0, 0, 0.0},
+};
+
+constexpr int kNumTransitions =
+    sizeof(kTransitions) / sizeof(kTransitions[0]);
+
+// Checked at compile time: rows are ordered, so candidates are listed with
+// the lower state first and win ties, and every state can be left.
+constexpr bool Ordered(int i) {
+  return i + 1 >= kNumTransitions ||
+         ((kTransitions[i].from < kTransitions[i + 1].from ||
+           (kTransitions[i].from == kTransitions[i + 1].from &&
+            kTransitions[i].to <= kTransitions[i + 1].to)) &&
+          Ordered(i + 1));
+}
+constexpr bool HasExit(int state, int i) {
+  return i < kNumTransitions &&
+         (kTransitions[i].from == state || HasExit(state, i + 1));
+}
+constexpr bool AllHaveExits(int state) {
+  return state >= kNumBehaviorStates ||
+         (HasExit(state, 0) && AllHaveExits(state + 1));
+}
+static_assert(Ordered(0), "transition rows must be ordered by from, to");
+static_assert(AllHaveExits(0), "every state needs a transition");
+
+}  // namespace
+
+const BehaviorStateInfo &BehaviorFsm::Info(BehaviorState state) {
+  return kStates[state];
+}
+
+void BehaviorFsm::Candidates(unsigned flags, int lane,
+                             BehaviorCandidates &candidates) const {
+  candidates.Clear();
+  for (int i = 0; i < kNumTransitions; i++) {
+    const BehaviorTransition &row = kTransitions[i];
+    if (row.from != state_) {
+      continue;
+    }
+    const int offset = kStates[row.to].target_lane;
+    const bool legal = (flags & row.require) == row.require &&
+                       (flags & row.forbid) == 0;
+    candidates.Add(row.to, lane + offset, offset != 0, row.cost, legal);
+  }
+}
+
+BehaviorState BehaviorFsm::Transition(int to) {
+  state_ = static_cast<BehaviorState>(to);
+  return state_;
+}
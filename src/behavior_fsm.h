@@ -0,0 +1,75 @@
+#ifndef BEHAVIOR_FSM_H_
+#define BEHAVIOR_FSM_H_
+
+#include "behavior_cost.h"
+
+// States of the behavior planner.
+enum BehaviorState {
+  kStateKeepLane,
+  kStatePrepareLeft,
+  kStatePrepareRight,
+  kStateChangeLeft,
+  kStateChangeRight,
+  kNumBehaviorStates
+};
+
+// What the planner observed this tick, as bits of one flag word.
+enum BehaviorFlag {
+  kCarAhead = 1 << 0,    // a car too close in front on our lane
+  kLeftLane = 1 << 1,    // there is a lane to our left
+  kRightLane = 1 << 2,   // there is a lane to our right
+  kLeftClear = 1 << 3,   // changing to the left lane is safe
+  kRightClear = 1 << 4,  // changing to the right lane is safe
+};
+
+// What to do with the speed while in a state.
+enum SpeedAction {
+  kSpeedUp,    // accelerate towards the speed limit
+  kMatchLead,  // follow the car in front
+  kKeepSpeed,
+};
+
+// One row of the transition table: from -> to is allowed at `cost` when
+// all `require` flags are set and none of the `forbid` flags. A pair may
+// have several rows; the cheapest one that applies counts.
+struct BehaviorTransition {
+  BehaviorState from;
+  BehaviorState to;
+  unsigned require;
+  unsigned forbid;
+  double cost;
+};
+
+// What a state does when it is entered.
+struct BehaviorStateInfo {
+  const char *name;
+  int target_lane;  // lane the state is about, relative to ours
+  int lane_shift;   // -1 left, +1 right
+  SpeedAction speed;
+};
+
+// Finite state machine driven by a constant transition table. Every tick
+// the rows leaving the current state are listed as candidates in one pass,
+// scored by a BehaviorCostModel, and the cheapest is taken with
+// Transition(). Transitions without a row are never candidates; rows whose
+// conditions do not hold are, but marked illegal.
+class BehaviorFsm {
+ public:
+  BehaviorFsm() : state_(kStateKeepLane) {}
+
+  BehaviorState state() const { return state_; }
+  const BehaviorStateInfo &info() const { return Info(state_); }
+
+  // Lists the transitions out of the current state, in table order, given
+  // this tick's flags and the lane we are on.
+  void Candidates(unsigned flags, int lane,
+                  BehaviorCandidates &candidates) const;
+  BehaviorState Transition(int to);
+
+  static const BehaviorStateInfo &Info(BehaviorState state);
+
+ private:
+  BehaviorState state_;
+};
+
+#endif  // BEHAVIOR_FSM_H_
@@ -0,0 +1,381 @@
+// Micro-benchmarks for the per-tick planner building blocks. Everything here
+// has to fit comfortably in the simulator's 20 ms tick.
+//
+//   ./planner_benchmark [num_threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "intent_classifier.h"
+#include "kalman_bank.h"
+#include "lane_geometry.h"
+#include "lane_index.h"
+#include "lane_sequence_planner.h"
+#include "lattice_planner.h"
+#include "motion_primitives.h"
+#include "oriented_box.h"
+#include "prediction.h"
+#include "spline.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+// The simulator's highway: a loop of this length with three 4 m lanes.
+const double kHighwayLength = 6945.554;
+
+const LaneGeometry &Highway() {
+  static const LaneGeometry lanes(kHighwayLength);
+  return lanes;
+}
+
+double ElapsedUs(Clock::time_point start) {
+  return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+void Report(const string &name, vector<double> &samples_us) {
+  sort(samples_us.begin(), samples_us.end());
+  double sum = 0;
+  for (double sample : samples_us) {
+    sum += sample;
+  }
+  size_t n = samples_us.size();
+  cout << name << ": mean " << sum / n << " us, median " << samples_us[n / 2]
+       << " us, p99 " << samples_us[n * 99 / 100] << " us, max "
+       << samples_us[n - 1] << " us" << endl;
+}
+
+// Fork/join cost of the pool: the tasks do nothing, so all of the time is
+// scheduling overhead.
+void BenchmarkThreadPool(ThreadPool &pool) {
+  const int kIterations = 20000;
+  vector<double> samples;
+  vector<int> sink(64);
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    pool.ParallelFor(0, 64, [&sink](int k) { sink[k]++; });
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("thread pool parallel_for(64 empty tasks)", samples);
+  cout << "  steals: " << pool.num_steals() << endl;
+}
+
+// One tick of the filter bank at full capacity: predict, queue a
+// measurement per vehicle, update.
+void BenchmarkKalmanBank() {
+  const int kIterations = 20000;
+  const int kVehicles = 128;
+  KalmanFilterBank kalman(kVehicles, kHighwayLength);
+  for (int k = 0; k < kVehicles; k++) {
+    kalman.Init(k, 10.0 * k, 20, 2 + 4 * (k % 3), 0);
+  }
+
+  vector<double> samples;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    kalman.Predict(0.06);
+    for (int k = 0; k < kVehicles; k++) {
+      kalman.SetMeasurement(k, 10.0 * k + 1.2 * i, 20, 2 + 4 * (k % 3), 0);
+    }
+    kalman.Update();
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("kalman filter bank tick (" + to_string(kVehicles) + " vehicles)",
+         samples);
+}
+
+// Per-tick broad phase for 128 vehicles: build and sort the lane lists, then
+// find the nearest car ahead and behind on every lane.
+void BenchmarkLaneIndex() {
+  const int kIterations = 20000;
+  const int kVehicles = 128;
+  srand(4);
+  vector<double> s(kVehicles), d(kVehicles);
+  for (int k = 0; k < kVehicles; k++) {
+    s[k] = 2000.0 * rand() / RAND_MAX;
+    d[k] = 12.0 * rand() / RAND_MAX;
+  }
+  LaneIndex index(Highway());
+
+  vector<double> samples;
+  double sink = 0;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    index.Clear();
+    for (int k = 0; k < kVehicles; k++) {
+      index.InsertAt(d[k], k, s[k]);
+    }
+    index.Sort();
+    for (int lane = 0; lane < 3; lane++) {
+      index.Visit(lane, 1000, 1030,
+                  [&sink](const LaneIndex::Entry &, double ds) {
+                    sink += ds;
+                  });
+      index.Visit(lane, 980, 1000,
+                  [&sink](const LaneIndex::Entry &, double ds) {
+                    sink += ds;
+                  });
+    }
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("lane index build + 6 queries (" + to_string(kVehicles) +
+             " vehicles)",
+         samples);
+}
+
+// Narrow phase: an ego lane change against one vehicle, 31 steps of 0.1 s.
+void BenchmarkBoxSeparation() {
+  const int kIterations = 20000;
+  const int kSteps = 31;
+  BoxPath ego, car;
+  ego.Resize(kSteps);
+  car.Resize(kSteps);
+  ego.half_length = car.half_length = 2.5;
+  ego.half_width = car.half_width = 1.25;
+  for (int k = 0; k < kSteps; k++) {
+    double t = 0.1 * k;
+    double heading = 0.1 * sin(t);
+    ego.x[k] = 20 * t;
+    ego.y[k] = 6 + 2 * sin(t);
+    ego.cos[k] = cos(heading);
+    ego.sin[k] = sin(heading);
+    car.x[k] = 15 + 18 * t;
+    car.y[k] = 10;
+    car.cos[k] = 1;
+    car.sin[k] = 0;
+  }
+
+  vector<double> scratch;
+  vector<double> samples;
+  double sink = 0;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    sink += MinBoxSeparation(kSteps, ego, car, scratch);
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("oriented box separation (31 steps)", samples);
+}
+
+// Multi-hypothesis prediction of a busy road: 40 vehicles, some of them
+// changing lanes or braking.
+void BenchmarkPrediction() {
+  const int kIterations = 2000;
+  srand(3);
+  vector<VehicleEstimate> vehicles;
+  for (int k = 0; k < 40; k++) {
+    VehicleEstimate vehicle;
+    vehicle.s = 1000.0 * rand() / RAND_MAX;
+    vehicle.d = 12.0 * rand() / RAND_MAX;
+    vehicle.speed_s = 15 + 7.0 * rand() / RAND_MAX;
+    vehicle.accel_s = 2.0 * rand() / RAND_MAX - 1.5;
+    vehicle.p_left = (k % 4 == 1) ? 0.3 : 0;
+    vehicle.p_right = (k % 4 == 2) ? 0.3 : 0;
+    vehicle.p_keep = 1 - vehicle.p_left - vehicle.p_right;
+    vehicles.push_back(vehicle);
+  }
+  TrajectoryPredictor prediction(Highway(), PredictionConfig());
+
+  vector<double> samples;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    prediction.Predict(vehicles);
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("trajectory prediction (40 vehicles, " +
+             to_string(prediction.num_hypotheses()) + " hypotheses x " +
+             to_string(prediction.num_steps()) + " steps)",
+         samples);
+}
+
+// Lane-change intent of a full tracker's worth of vehicles.
+void BenchmarkIntentClassifier() {
+  const int kIterations = 20000;
+  const int kVehicles = 128;
+  IntentClassifier classifier;
+  if (!classifier.Load("../data/intent_model.txt")) {
+    cout << "(../data/intent_model.txt not found, using built-in model)"
+         << endl;
+  }
+
+  srand(2);
+  vector<double> s(kVehicles), d(kVehicles), speed_d(kVehicles);
+  for (int k = 0; k < kVehicles; k++) {
+    s[k] = 1000.0 * rand() / RAND_MAX;
+    d[k] = 12.0 * rand() / RAND_MAX;
+    speed_d[k] = 4.0 * rand() / RAND_MAX - 2;
+  }
+  vector<double> p_keep(kVehicles), p_left(kVehicles), p_right(kVehicles);
+
+  vector<double> samples;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    classifier.Classify(Highway(), kVehicles, s.data(), d.data(),
+                        speed_d.data(), p_keep.data(), p_left.data(),
+                        p_right.data());
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("intent classifier (" + to_string(kVehicles) + " vehicles)",
+         samples);
+}
+
+// Lane sequence search over 10 s among 12 vehicles that may change lanes.
+void BenchmarkLaneSequencePlanner() {
+  const int kIterations = 2000;
+  LaneSequenceConfig config;
+  LaneSequencePlanner planner(Highway(), config);
+
+  srand(1);
+  vector<VehicleEstimate> vehicles;
+  for (int i = 0; i < 12; i++) {
+    VehicleEstimate vehicle;
+    vehicle.s = 100 + 300.0 * rand() / RAND_MAX;
+    vehicle.d = 2 + 4 * (rand() % 3);
+    vehicle.speed_s = 16 + 6.0 * rand() / RAND_MAX;
+    vehicle.accel_s = 0;
+    vehicle.p_keep = 0.8;
+    vehicle.p_left = vehicle.d > 4 ? 0.2 : 0;
+    vehicle.p_right = vehicle.d > 4 ? 0 : 0.2;
+    vehicles.push_back(vehicle);
+  }
+  TrajectoryPredictor prediction(Highway(), PredictionConfig());
+  prediction.Predict(vehicles);
+
+  vector<double> samples;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    planner.Plan(1, 120, 20, 0, prediction);
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("lane sequence planner (" + to_string(config.num_steps) +
+             " steps x " + to_string(Highway().num_lanes()) + " lanes, " +
+             to_string(prediction.num_hypotheses()) + " hypotheses)",
+         samples);
+}
+
+// The 50 lateral offsets of a lane change path, fitting a spline through
+// the anchors every time as the walkthrough does, and from the motion
+// primitive of the speed band.
+void BenchmarkMotionPrimitives() {
+  const int kIterations = 20000;
+  const int kPoints = 50;
+  MotionPrimitiveLibrary library;
+  const MotionPrimitive &primitive = library.Lookup(22);
+  const double anchor_y[MotionPrimitive::kNumAnchors] = {4.1, 4.3, 4.6};
+
+  vector<double> samples;
+  double sink = 0;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    vector<double> x(5), y(5);
+    x[0] = -0.44;
+    x[1] = 0;
+    y[0] = y[1] = 0;
+    for (int k = 0; k < MotionPrimitive::kNumAnchors; k++) {
+      x[k + 2] = (k + 1) * primitive.spacing();
+      y[k + 2] = anchor_y[k];
+    }
+    tk::spline spline;
+    spline.set_points(x, y);
+    for (int p = 0; p < kPoints; p++) {
+      sink += spline(0.44 * p);
+    }
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("lane change path, spline fit (" + to_string(kPoints) + " points)",
+         samples);
+
+  samples.clear();
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    for (int p = 0; p < kPoints; p++) {
+      sink += primitive.Offset(anchor_y, 0.44 * p);
+    }
+    samples.push_back(ElapsedUs(start));
+  }
+  Report("lane change path, motion primitive (" + to_string(kPoints) +
+             " points)",
+         samples);
+  if (sink == 0) {
+    cout << endl;
+  }
+}
+
+void BenchmarkLatticePlanner(ThreadPool &pool, bool anytime) {
+  const int kIterations = 2000;
+  LatticeConfig config;
+  config.anytime = anytime;
+  LatticePlanner planner(&pool, Highway(), config);
+
+  srand(1);
+  vector<Obstacle> obstacles;
+  vector<VehicleEstimate> vehicles;
+  for (int i = 0; i < 12; i++) {
+    Obstacle obstacle;
+    obstacle.s = 100 + 300.0 * rand() / RAND_MAX;
+    obstacle.d = 2 + 4 * (rand() % 3);
+    obstacle.speed_s = 16 + 6.0 * rand() / RAND_MAX;
+    obstacle.speed_d = 0;
+    obstacle.accel_s = 0;
+    obstacles.push_back(obstacle);
+
+    // Every vehicle with a lane change hypothesis as well
+    VehicleEstimate vehicle;
+    vehicle.s = obstacle.s;
+    vehicle.d = obstacle.d;
+    vehicle.speed_s = obstacle.speed_s;
+    vehicle.accel_s = 0;
+    vehicle.p_keep = 0.8;
+    vehicle.p_left = obstacle.d > 4 ? 0.2 : 0;
+    vehicle.p_right = obstacle.d > 4 ? 0 : 0.2;
+    vehicles.push_back(vehicle);
+  }
+  TrajectoryPredictor prediction(Highway(), PredictionConfig());
+  prediction.Predict(vehicles);
+  EgoState ego;
+  ego.s = 120;
+  ego.d = 6;
+  ego.speed = 20;
+  ego.time = 0;
+
+  vector<double> samples;
+  for (int i = 0; i < kIterations; i++) {
+    Clock::time_point start = Clock::now();
+    planner.Plan(ego, obstacles, prediction);
+    samples.push_back(ElapsedUs(start));
+  }
+  Report(string(anytime ? "anytime" : "lattice") + " planner (" +
+             to_string(planner.num_candidates()) + " candidates, 12 vehicles)",
+         samples);
+  cout << "  deadline hits: " << planner.num_deadline_hits() << "/"
+       << planner.num_plans() << endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  int num_threads = max(1u, thread::hardware_concurrency());
+  if (argc > 1) {
+    num_threads = atoi(argv[1]);
+  }
+  cout << "threads: " << num_threads << endl;
+
+  ThreadPool pool(num_threads, true);
+  BenchmarkThreadPool(pool);
+  BenchmarkKalmanBank();
+  BenchmarkIntentClassifier();
+  BenchmarkLaneIndex();
+  BenchmarkBoxSeparation();
+  BenchmarkPrediction();
+  BenchmarkLaneSequencePlanner();
+  BenchmarkMotionPrimitives();
+  BenchmarkLatticePlanner(pool, false);
+  BenchmarkLatticePlanner(pool, true);
+}
@@ -0,0 +1,26 @@
+#include "car_following.h"
+
+#include <algorithm>
+#include <cmath>
+
+CarFollowingConfig::CarFollowingConfig()
+    : max_accel(5.0),
+      comfort_decel(3.0),
+      time_gap(1.0),
+      min_gap(2.0),
+      car_length(5.0) {}
+
+double CarFollowing::GapAccel(double speed, double distance,
+                              double lead_speed) const {
+  // Desired gap s* = s0 + v T + v dv / (2 sqrt(a b))
+  const double closing = speed - lead_speed;
+  const double desired_gap =
+      config_.min_gap +
+      std::max(0.0, speed * config_.time_gap +
+                        speed * closing /
+                            (2 * std::sqrt(config_.max_accel *
+                                           config_.comfort_decel)));
+  const double gap = std::max(distance - config_.car_length, 0.1);
+  const double ratio = desired_gap / gap;
+  return config_.max_accel * (1 - ratio * ratio);
+}
@@ -0,0 +1,31 @@
+#ifndef CAR_FOLLOWING_H_
+#define CAR_FOLLOWING_H_
+
+struct CarFollowingConfig {
+  CarFollowingConfig();
+
+  double max_accel;      // a, m/s^2
+  double comfort_decel;  // b, m/s^2, positive
+  double time_gap;       // T, s
+  double min_gap;        // s0, m, bumper to bumper at standstill
+  double car_length;     // m, to turn center distances into gaps
+};
+
+// Interaction term of the Intelligent Driver Model: settles at a gap of
+// about min_gap + time_gap * speed behind a slower car, braking harder the
+// faster the gap closes. The free-road term is left to the caller's own
+// speed control, and the smaller of the two applies, as in the IDM+ form.
+// Closed form, so it can be evaluated for every path point.
+class CarFollowing {
+ public:
+  explicit CarFollowing(const CarFollowingConfig &config) : config_(config) {}
+
+  // Acceleration at `speed` that keeps the gap to a car `distance` metres
+  // ahead (center to center) driving at lead_speed.
+  double GapAccel(double speed, double distance, double lead_speed) const;
+
+ private:
+  CarFollowingConfig config_;
+};
+
+#endif  // CAR_FOLLOWING_H_
@@ -0,0 +1,54 @@
+#include "frenet_projector.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrenetProjector::FrenetProjector(const std::vector<double> &maps_s,
+                                 const std::vector<double> &maps_dx,
+                                 const std::vector<double> &maps_dy,
+                                 double max_s)
+    : max_s_(max_s) {
+  const int n = static_cast<int>(maps_s.size());
+  start_s_ = maps_s;
+  nx_ = maps_dx;
+  ny_ = maps_dy;
+  inv_length_.resize(n);
+  dnx_.resize(n);
+  dny_.resize(n);
+  for (int i = 0; i < n; i++) {
+    // The last segment closes the loop back to the first waypoint.
+    int next = (i + 1) % n;
+    double end_s = (next == 0) ? max_s : maps_s[next];
+    inv_length_[i] = 1.0 / (end_s - maps_s[i]);
+    dnx_[i] = maps_dx[next] - maps_dx[i];
+    dny_[i] = maps_dy[next] - maps_dy[i];
+  }
+}
+
+int FrenetProjector::Segment(double s) const {
+  int segment = static_cast<int>(
+      std::upper_bound(start_s_.begin(), start_s_.end(), s) -
+      start_s_.begin()) - 1;
+  return std::max(segment, 0);
+}
+
+void FrenetProjector::Project(int n, const double *s, const double *vx,
+                              const double *vy, double *speed_s,
+                              double *speed_d) const {
+  for (int i = 0; i < n; i++) {
+    double wrapped_s = std::fmod(s[i], max_s_);
+    if (wrapped_s < 0) {
+      wrapped_s += max_s_;
+    }
+    int segment = Segment(wrapped_s);
+    double f = (wrapped_s - start_s_[segment]) * inv_length_[segment];
+    double nx = nx_[segment] + f * dnx_[segment];
+    double ny = ny_[segment] + f * dny_[segment];
+    // Interpolating two unit vectors shortens them slightly.
+    double inv_norm = 1.0 / std::sqrt(nx * nx + ny * ny);
+
+    // Tangent (-ny, nx), normal (nx, ny).
+    speed_s[i] = (vy[i] * nx - vx[i] * ny) * inv_norm;
+    speed_d[i] = (vx[i] * nx + vy[i] * ny) * inv_norm;
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef FRENET_PROJECTOR_H_
+#define FRENET_PROJECTOR_H_
+
+#include <vector>
+
+// Splits world-frame velocities into their components along and across the
+// road, using the map's waypoint normals instead of per-vehicle trig.
+//
+// The road between two waypoints is one segment. Each segment caches its
+// start s, inverse length and the normal at both ends; the normal at any s
+// is interpolated linearly between them, and the tangent is the normal
+// turned a quarter to the left.
+class FrenetProjector {
+ public:
+  FrenetProjector() : max_s_(0) {}
+  // maps_dx/maps_dy are the unit normals of the waypoints, pointing to the
+  // right of the direction of travel. s wraps around at max_s.
+  FrenetProjector(const std::vector<double> &maps_s,
+                  const std::vector<double> &maps_dx,
+                  const std::vector<double> &maps_dy, double max_s);
+
+  // For n vehicles at arc length s[i] moving with (vx[i], vy[i]), writes the
+  // speed along the road to speed_s[i] and the speed across it, positive to
+  // the right, to speed_d[i].
+  void Project(int n, const double *s, const double *vx, const double *vy,
+               double *speed_s, double *speed_d) const;
+
+ private:
+  // Index of the segment containing s, which must be in [0, max_s).
+  int Segment(double s) const;
+
+  double max_s_;
+  // Per segment.
+  std::vector<double> start_s_;
+  std::vector<double> inv_length_;
+  std::vector<double> nx_, ny_;    // normal at the start
+  std::vector<double> dnx_, dny_;  // normal at the end minus at the start
+};
+
+#endif  // FRENET_PROJECTOR_H_
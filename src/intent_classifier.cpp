@@ -0,0 +1,124 @@
+#include "intent_classifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Log probability given to lane changes off the road; exp() of it is 0.
+const double kImpossible = -1e30;
+
+}  // namespace
+
+IntentClassifier::IntentClassifier() {
+  SetClass(kKeepLane, 0.90, 0.0, 0.16, 0.0, 0.04);
+  SetClass(kChangeLeft, 0.05, -0.5, 1.5, -1.5, 0.5);
+  SetClass(kChangeRight, 0.05, 0.5, 1.5, 1.5, 0.5);
+}
+
+void IntentClassifier::SetClass(LaneIntent intent, double prior,
+                                double mean_offset, double var_offset,
+                                double mean_speed_d, double var_speed_d) {
+  ClassModel &model = classes_[intent];
+  model.log_prior = std::log(prior) -
+                    0.5 * std::log(2 * M_PI * var_offset) -
+                    0.5 * std::log(2 * M_PI * var_speed_d);
+  model.mean_offset = mean_offset;
+  model.mean_speed_d = mean_speed_d;
+  model.inv_two_var_offset = 0.5 / var_offset;
+  model.inv_two_var_speed_d = 0.5 / var_speed_d;
+}
+
+bool IntentClassifier::Load(const std::string &path) {
+  std::ifstream in(path.c_str());
+  if (!in) {
+    return false;
+  }
+
+  IntentClassifier loaded;
+  bool seen[kNumLaneIntents] = {false, false, false};
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream iss(line);
+    std::string key;
+    if (!(iss >> key) || key[0] == '#') {
+      continue;
+    }
+    LaneIntent intent;
+    if (key == "keep") {
+      intent = kKeepLane;
+    } else if (key == "left") {
+      intent = kChangeLeft;
+    } else if (key == "right") {
+      intent = kChangeRight;
+    } else {
+      return false;
+    }
+    double prior, mean_offset, var_offset, mean_speed_d, var_speed_d;
+    if (!(iss >> prior >> mean_offset >> var_offset >> mean_speed_d >>
+          var_speed_d) ||
+        prior <= 0 || var_offset <= 0 || var_speed_d <= 0) {
+      return false;
+    }
+    loaded.SetClass(intent, prior, mean_offset, var_offset, mean_speed_d,
+                    var_speed_d);
+    seen[intent] = true;
+  }
+
+  if (!seen[kKeepLane] || !seen[kChangeLeft] || !seen[kChangeRight]) {
+    return false;
+  }
+  *this = loaded;
+  return true;
+}
+
+void IntentClassifier::Classify(const LaneGeometry &lanes, int n,
+                                const double *s, const double *d,
+                                const double *speed_d, double *p_keep,
+                                double *p_left, double *p_right) const {
+  const ClassModel &keep = classes_[kKeepLane];
+  const ClassModel &left = classes_[kChangeLeft];
+  const ClassModel &right = classes_[kChangeRight];
+
+  for (int i = 0; i < n; i++) {
+    const double lane_width = lanes.lane_width_at(s[i]);
+    const double max_lane = lanes.num_lanes_at(s[i]) - 1;
+    double lane = std::floor(d[i] / lane_width);
+    lane = std::min(std::max(lane, 0.0), max_lane);
+    const double offset = d[i] - lane_width * (lane + 0.5);
+    const double w = speed_d[i];
+
+    double lp_keep =
+        keep.log_prior -
+        (offset - keep.mean_offset) * (offset - keep.mean_offset) *
+            keep.inv_two_var_offset -
+        (w - keep.mean_speed_d) * (w - keep.mean_speed_d) *
+            keep.inv_two_var_speed_d;
+    double lp_left =
+        left.log_prior -
+        (offset - left.mean_offset) * (offset - left.mean_offset) *
+            left.inv_two_var_offset -
+        (w - left.mean_speed_d) * (w - left.mean_speed_d) *
+            left.inv_two_var_speed_d;
+    double lp_right =
+        right.log_prior -
+        (offset - right.mean_offset) * (offset - right.mean_offset) *
+            right.inv_two_var_offset -
+        (w - right.mean_speed_d) * (w - right.mean_speed_d) *
+            right.inv_two_var_speed_d;
+    lp_left = (lane > 0) ? lp_left : kImpossible;
+    lp_right = (lane < max_lane) ? lp_right : kImpossible;
+
+    // Normalize in log space so the largest term is exp(0).
+    const double lp_max = std::max(lp_keep, std::max(lp_left, lp_right));
+    const double e_keep = std::exp(lp_keep - lp_max);
+    const double e_left = std::exp(lp_left - lp_max);
+    const double e_right = std::exp(lp_right - lp_max);
+    const double inv_sum = 1.0 / (e_keep + e_left + e_right);
+    p_keep[i] = e_keep * inv_sum;
+    p_left[i] = e_left * inv_sum;
+    p_right[i] = e_right * inv_sum;
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef INTENT_CLASSIFIER_H_
+#define INTENT_CLASSIFIER_H_
+
+#include <string>
+
+#include "lane_geometry.h"
+
+// What a vehicle is about to do with its lane.
+enum LaneIntent { kKeepLane, kChangeLeft, kChangeRight, kNumLaneIntents };
+
+// Gaussian naive Bayes classifier of lane-change intent. The features are
+// the offset of a vehicle from the center of its lane and its speed across
+// the road, both positive to the right; each intent models them as
+// independent normal distributions.
+class IntentClassifier {
+ public:
+  // Starts with the parameters shipped in data/intent_model.txt.
+  IntentClassifier();
+
+  // Reads the parameters from a file; see data/intent_model.txt for the
+  // format. Returns false, keeping the current parameters, if the file
+  // cannot be read or is incomplete.
+  bool Load(const std::string &path);
+
+  // Scores n vehicles at once: writes the probability of keeping the lane,
+  // changing left and changing right for vehicle i to the i-th entry of
+  // p_keep, p_left and p_right. Lanes are those of `lanes` at each
+  // vehicle's s; changes off the road get probability zero.
+  void Classify(const LaneGeometry &lanes, int n, const double *s,
+                const double *d, const double *speed_d, double *p_keep,
+                double *p_left, double *p_right) const;
+
+ private:
+  // Feature distribution of one intent, stored ready for the log density.
+  struct ClassModel {
+    double log_prior;  // includes the normalizers of both Gaussians
+    double mean_offset;
+    double mean_speed_d;
+    double inv_two_var_offset;   // 1 / (2 var)
+    double inv_two_var_speed_d;
+  };
+
+  void SetClass(LaneIntent intent, double prior, double mean_offset,
+                double var_offset, double mean_speed_d, double var_speed_d);
+
+  ClassModel classes_[kNumLaneIntents];
+};
+
+#endif  // INTENT_CLASSIFIER_H_
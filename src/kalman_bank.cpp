@@ -0,0 +1,225 @@
+#include "kalman_bank.h"
+
+#include <algorithm>
+
+namespace {
+
+// Process noise covariance for one step, upper triangle.
+struct NoiseAlong {
+  double ss, sv, sa, vv, va, aa;
+};
+struct NoiseAcross {
+  double dd, dw, ww;
+};
+
+// The kernels below take every array as a separate restrict pointer so the
+// compiler knows they do not alias and vectorizes the loops across vehicles.
+
+void PredictAlong(int n, double h, const NoiseAlong &q, double *__restrict s,
+                  double *__restrict v, double *__restrict a,
+                  double *__restrict p_ss, double *__restrict p_sv,
+                  double *__restrict p_sa, double *__restrict p_vv,
+                  double *__restrict p_va, double *__restrict p_aa) {
+  const double h2 = h * h / 2;
+  for (int i = 0; i < n; i++) {
+    s[i] += h * v[i] + h2 * a[i];
+    v[i] += h * a[i];
+
+    // P = F P F^T + Q with F = [1 h h2; 0 1 h; 0 0 1], written out.
+    const double fp0_s = p_ss[i] + h * p_sv[i] + h2 * p_sa[i];
+    const double fp0_v = p_sv[i] + h * p_vv[i] + h2 * p_va[i];
+    const double fp0_a = p_sa[i] + h * p_va[i] + h2 * p_aa[i];
+    const double fp1_v = p_vv[i] + h * p_va[i];
+    const double fp1_a = p_va[i] + h * p_aa[i];
+
+    p_ss[i] = fp0_s + h * fp0_v + h2 * fp0_a + q.ss;
+    p_sv[i] = fp0_v + h * fp0_a + q.sv;
+    p_sa[i] = fp0_a + q.sa;
+    p_vv[i] = fp1_v + h * fp1_a + q.vv;
+    p_va[i] = fp1_a + q.va;
+    p_aa[i] = p_aa[i] + q.aa;
+  }
+}
+
+void PredictAcross(int n, double h, const NoiseAcross &q,
+                   double *__restrict d, double *__restrict w,
+                   double *__restrict p_dd, double *__restrict p_dw,
+                   double *__restrict p_ww) {
+  for (int i = 0; i < n; i++) {
+    d[i] += h * w[i];
+
+    // F = [1 h; 0 1].
+    p_dd[i] += 2 * h * p_dw[i] + h * h * p_ww[i] + q.dd;
+    p_dw[i] += h * p_ww[i] + q.dw;
+    p_ww[i] += q.ww;
+  }
+}
+
+// Measures (s, s_dot), H = [1 0 0; 0 1 0]. Slots with mask 0 get zero gain.
+void UpdateAlong(int n, double max_s, double r_s, double r_v,
+                 const double *__restrict z_s, const double *__restrict z_v,
+                 const double *__restrict mask, double *__restrict s,
+                 double *__restrict v, double *__restrict a,
+                 double *__restrict p_ss, double *__restrict p_sv,
+                 double *__restrict p_sa, double *__restrict p_vv,
+                 double *__restrict p_va, double *__restrict p_aa) {
+  for (int i = 0; i < n; i++) {
+    const double s00 = p_ss[i] + r_s;
+    const double s01 = p_sv[i];
+    const double s11 = p_vv[i] + r_v;
+    const double inv_det = mask[i] / (s00 * s11 - s01 * s01);
+    const double i00 = s11 * inv_det;
+    const double i01 = -s01 * inv_det;
+    const double i11 = s00 * inv_det;
+
+    // K = P H^T S^-1; rows are (s, s_dot, s_ddot).
+    const double k00 = p_ss[i] * i00 + p_sv[i] * i01;
+    const double k01 = p_ss[i] * i01 + p_sv[i] * i11;
+    const double k10 = p_sv[i] * i00 + p_vv[i] * i01;
+    const double k11 = p_sv[i] * i01 + p_vv[i] * i11;
+    const double k20 = p_sa[i] * i00 + p_va[i] * i01;
+    const double k21 = p_sa[i] * i01 + p_va[i] * i11;
+
+    // Residual across the wrap of s, without a branch.
+    double y_s = z_s[i] - s[i];
+    const double wrap_down = (y_s > max_s / 2) ? max_s : 0.0;
+    const double wrap_up = (y_s < -max_s / 2) ? max_s : 0.0;
+    y_s += wrap_up - wrap_down;
+    const double y_v = z_v[i] - v[i];
+
+    s[i] += k00 * y_s + k01 * y_v;
+    v[i] += k10 * y_s + k11 * y_v;
+    a[i] += k20 * y_s + k21 * y_v;
+
+    // P = (I - K H) P
+    const double ss = p_ss[i], sv = p_sv[i], sa = p_sa[i];
+    const double vv = p_vv[i], va = p_va[i];
+    p_ss[i] = ss - (k00 * ss + k01 * sv);
+    p_sv[i] = sv - (k00 * sv + k01 * vv);
+    p_sa[i] = sa - (k00 * sa + k01 * va);
+    p_vv[i] = vv - (k10 * sv + k11 * vv);
+    p_va[i] = va - (k10 * sa + k11 * va);
+    p_aa[i] = p_aa[i] - (k20 * sa + k21 * va);
+  }
+}
+
+// Measures (d, d_dot), H = I.
+void UpdateAcross(int n, double r_d, double r_w, const double *__restrict z_d,
+                  const double *__restrict z_w,
+                  const double *__restrict mask, double *__restrict d,
+                  double *__restrict w, double *__restrict p_dd,
+                  double *__restrict p_dw, double *__restrict p_ww) {
+  for (int i = 0; i < n; i++) {
+    const double s00 = p_dd[i] + r_d;
+    const double s01 = p_dw[i];
+    const double s11 = p_ww[i] + r_w;
+    const double inv_det = mask[i] / (s00 * s11 - s01 * s01);
+    const double i00 = s11 * inv_det;
+    const double i01 = -s01 * inv_det;
+    const double i11 = s00 * inv_det;
+
+    // K = P S^-1; rows are (d, d_dot).
+    const double k00 = p_dd[i] * i00 + p_dw[i] * i01;
+    const double k01 = p_dd[i] * i01 + p_dw[i] * i11;
+    const double k10 = p_dw[i] * i00 + p_ww[i] * i01;
+    const double k11 = p_dw[i] * i01 + p_ww[i] * i11;
+
+    const double y_d = z_d[i] - d[i];
+    const double y_w = z_w[i] - w[i];
+    d[i] += k00 * y_d + k01 * y_w;
+    w[i] += k10 * y_d + k11 * y_w;
+
+    // P = (I - K) P
+    const double dd = p_dd[i], dw = p_dw[i], ww = p_ww[i];
+    p_dd[i] = dd - (k00 * dd + k01 * dw);
+    p_dw[i] = dw - (k00 * dw + k01 * ww);
+    p_ww[i] = ww - (k10 * dw + k11 * ww);
+  }
+}
+
+}  // namespace
+
+KalmanFilterBank::KalmanFilterBank(int capacity, double max_s)
+    : capacity_(capacity), max_s_(max_s),
+      s_(capacity), v_(capacity), a_(capacity), d_(capacity), w_(capacity),
+      p_ss_(capacity), p_sv_(capacity), p_sa_(capacity), p_vv_(capacity),
+      p_va_(capacity), p_aa_(capacity), p_dd_(capacity), p_dw_(capacity),
+      p_ww_(capacity), z_s_(capacity), z_v_(capacity), z_d_(capacity),
+      z_w_(capacity), mask_(capacity),
+      q_s_(2.0), q_d_(0.5), r_s_(0.25), r_v_(0.25), r_d_(0.04), r_w_(0.09) {}
+
+void KalmanFilterBank::Init(int index, double s, double speed_s, double d,
+                            double speed_d) {
+  s_[index] = s;
+  v_[index] = speed_s;
+  a_[index] = 0;
+  d_[index] = d;
+  w_[index] = speed_d;
+
+  p_ss_[index] = r_s_;
+  p_sv_[index] = 0;
+  p_sa_[index] = 0;
+  p_vv_[index] = r_v_;
+  p_va_[index] = 0;
+  p_aa_[index] = 4.0;
+  p_dd_[index] = r_d_;
+  p_dw_[index] = 0;
+  p_ww_[index] = r_w_;
+
+  mask_[index] = 0;
+}
+
+void KalmanFilterBank::SetMeasurement(int index, double s, double speed_s,
+                                      double d, double speed_d) {
+  z_s_[index] = s;
+  z_v_[index] = speed_s;
+  z_d_[index] = d;
+  z_w_[index] = speed_d;
+  mask_[index] = 1;
+}
+
+void KalmanFilterBank::Predict(double dt) {
+  // Discretized white-noise jerk (along) and acceleration (across) models.
+  NoiseAlong q_along;
+  q_along.ss = q_s_ * dt * dt * dt * dt * dt / 20;
+  q_along.sv = q_s_ * dt * dt * dt * dt / 8;
+  q_along.sa = q_s_ * dt * dt * dt / 6;
+  q_along.vv = q_s_ * dt * dt * dt / 3;
+  q_along.va = q_s_ * dt * dt / 2;
+  q_along.aa = q_s_ * dt;
+  NoiseAcross q_across;
+  q_across.dd = q_d_ * dt * dt * dt / 3;
+  q_across.dw = q_d_ * dt * dt / 2;
+  q_across.ww = q_d_ * dt;
+
+  PredictAlong(capacity_, dt, q_along, s_.data(), v_.data(), a_.data(),
+               p_ss_.data(), p_sv_.data(), p_sa_.data(), p_vv_.data(),
+               p_va_.data(), p_aa_.data());
+  PredictAcross(capacity_, dt, q_across, d_.data(), w_.data(), p_dd_.data(),
+                p_dw_.data(), p_ww_.data());
+}
+
+void KalmanFilterBank::Update() {
+  UpdateAlong(capacity_, max_s_, r_s_, r_v_, z_s_.data(), z_v_.data(),
+              mask_.data(), s_.data(), v_.data(), a_.data(), p_ss_.data(),
+              p_sv_.data(), p_sa_.data(), p_vv_.data(), p_va_.data(),
+              p_aa_.data());
+  UpdateAcross(capacity_, r_d_, r_w_, z_d_.data(), z_w_.data(), mask_.data(),
+               d_.data(), w_.data(), p_dd_.data(), p_dw_.data(),
+               p_ww_.data());
+  std::fill(mask_.begin(), mask_.end(), 0.0);
+}
+
+double KalmanFilterBank::PredictS(int index, double dt) const {
+  const double v = v_[index];
+  const double a = a_[index];
+  if (a < 0 && v + a * dt < 0) {
+    dt = v / -a;
+  }
+  return s_[index] + v * dt + 0.5 * a * dt * dt;
+}
+
+double KalmanFilterBank::PredictSpeedS(int index, double dt) const {
+  double speed = v_[index] + a_[index] * dt;
+  return speed > 0 ? speed : 0;
+}
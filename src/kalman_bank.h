@@ -0,0 +1,73 @@
+#ifndef KALMAN_BANK_H_
+#define KALMAN_BANK_H_
+
+#include <vector>
+
+// Bank of Kalman filters estimating the Frenet state of all tracked
+// vehicles: constant acceleration along the road (s, s_dot, s_ddot) and
+// constant velocity across it (d, d_dot). The two blocks are independent.
+//
+// Filters are stored structure-of-arrays, one array per state and
+// covariance entry, indexed like the Tracker's tracks. Predict() and
+// Update() run over every slot with straight-line arithmetic so the
+// compiler can vectorize them across vehicles; slots without a
+// measurement this tick are masked out of the update instead of branched
+// around.
+class KalmanFilterBank {
+ public:
+  // s wraps around at max_s, the length of the loop.
+  KalmanFilterBank(int capacity, double max_s);
+
+  // Restarts the filter of a newly tracked vehicle at the measurement.
+  void Init(int index, double s, double speed_s, double d, double speed_d);
+  // Queues a measurement for the next Update().
+  void SetMeasurement(int index, double s, double speed_s, double d,
+                      double speed_d);
+
+  // Propagates every filter by dt seconds.
+  void Predict(double dt);
+  // Applies the queued measurements and clears them.
+  void Update();
+
+  double s(int index) const { return s_[index]; }
+  double speed_s(int index) const { return v_[index]; }
+  double accel_s(int index) const { return a_[index]; }
+  double d(int index) const { return d_[index]; }
+  double speed_d(int index) const { return w_[index]; }
+
+  // Whole arrays, for batched consumers. Unused slots hold stale values.
+  int capacity() const { return capacity_; }
+  const double *s_data() const { return s_.data(); }
+  const double *d_data() const { return d_.data(); }
+  const double *speed_d_data() const { return w_.data(); }
+
+  // s after dt seconds at the estimated acceleration, stopping rather than
+  // reversing when decelerating.
+  double PredictS(int index, double dt) const;
+  double PredictSpeedS(int index, double dt) const;
+
+ private:
+  int capacity_;
+  double max_s_;
+
+  // State.
+  std::vector<double> s_, v_, a_;  // along the road
+  std::vector<double> d_, w_;      // across the road
+  // Covariance, upper triangle of each block.
+  std::vector<double> p_ss_, p_sv_, p_sa_, p_vv_, p_va_, p_aa_;
+  std::vector<double> p_dd_, p_dw_, p_ww_;
+  // Queued measurements; mask_ is 1 where there is one, 0 elsewhere.
+  std::vector<double> z_s_, z_v_, z_d_, z_w_, mask_;
+
+  // Process noise: spectral densities of the jerk along and of the
+  // acceleration across the road.
+  double q_s_;
+  double q_d_;
+  // Measurement noise variances.
+  double r_s_;
+  double r_v_;
+  double r_d_;
+  double r_w_;
+};
+
+#endif  // KALMAN_BANK_H_
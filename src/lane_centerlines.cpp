@@ -0,0 +1,161 @@
+#include "lane_centerlines.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The reference line is straight between waypoints and kinks at them, so
+// curvature is taken as the turn of the heading over this much road rather
+// than between neighbouring samples.
+const double kCurvatureSpan = 30.0;  // m
+
+// Angle difference in (-pi, pi].
+double WrapAngle(double angle) {
+  while (angle > M_PI) {
+    angle -= 2 * M_PI;
+  }
+  while (angle <= -M_PI) {
+    angle += 2 * M_PI;
+  }
+  return angle;
+}
+
+}  // namespace
+
+LaneCenterlines::LaneCenterlines()
+    : max_s_(0), step_(1), inv_step_(1), num_samples_(0), num_lanes_(0) {}
+
+void LaneCenterlines::Build(const LaneGeometry &lanes, double step,
+                            const ToXY &to_xy) {
+  const double max_s = lanes.max_s();
+  max_s_ = max_s;
+  // A whole number of intervals, so the last sample closes the loop.
+  const int m = std::max(2, static_cast<int>(max_s / step + 0.5));
+  step_ = max_s / m;
+  inv_step_ = 1 / step_;
+  num_samples_ = m + 1;
+  num_lanes_ = lanes.num_lanes();
+
+  const int size = num_lanes_ * num_samples_;
+  x_.resize(size);
+  y_.resize(size);
+  d_.resize(size);
+  curvature_.resize(size);
+  // Arc length from s = 0 and heading of one lane's samples.
+  std::vector<double> lane_s(num_samples_);
+  std::vector<double> heading(num_samples_);
+
+  // Headings and curvatures look around the loop: sample m is sample 0.
+  const int window =
+      std::max(1, static_cast<int>(kCurvatureSpan / 2 / step_));
+  for (int lane = 0; lane < num_lanes_; lane++) {
+    const int o = Offset(lane);
+    for (int i = 0; i < num_samples_; i++) {
+      // Sampling the loop's end at 0 keeps both ends equal.
+      const double s = (i < m) ? i * step_ : 0;
+      d_[o + i] = lanes.Center(lane, s);
+      to_xy(s, d_[o + i], &x_[o + i], &y_[o + i]);
+    }
+
+    lane_s[0] = 0;
+    for (int i = 1; i < num_samples_; i++) {
+      lane_s[i] = lane_s[i - 1] + std::hypot(x_[o + i] - x_[o + i - 1],
+                                             y_[o + i] - y_[o + i - 1]);
+    }
+    const double lap = lane_s[m];
+
+    for (int i = 0; i < num_samples_; i++) {
+      const int prev = o + (i + m - 1) % m;
+      const int next = o + (i + 1) % m;
+      heading[i] = std::atan2(y_[next] - y_[prev], x_[next] - x_[prev]);
+    }
+    for (int i = 0; i < num_samples_; i++) {
+      const int back = (i % m + m - window) % m;
+      const int ahead = (i + window) % m;
+      double length = lane_s[ahead] - lane_s[back];
+      if (length <= 0) {
+        length += lap;
+      }
+      curvature_[o + i] = WrapAngle(heading[ahead] - heading[back]) / length;
+    }
+  }
+}
+
+int LaneCenterlines::Locate(double s, double *f) const {
+  s = std::fmod(s, max_s_);
+  if (s < 0) {
+    s += max_s_;
+  }
+  const double t = s * inv_step_;
+  const int i = std::min(static_cast<int>(t), num_samples_ - 2);
+  *f = t - i;
+  return i;
+}
+
+void LaneCenterlines::Position(int lane, double s, double *x,
+                               double *y) const {
+  double f;
+  const int o = Offset(lane) + Locate(s, &f);
+  *x = x_[o] + f * (x_[o + 1] - x_[o]);
+  *y = y_[o] + f * (y_[o + 1] - y_[o]);
+}
+
+double LaneCenterlines::MaxCurvatureAhead(int lane, double s,
+                                          double distance) const {
+  const int m = num_samples_ - 1;
+  double f;
+  const int first = Locate(s, &f);
+  const int count = static_cast<int>(std::ceil(distance * inv_step_));
+  const double *kappa = &curvature_[Offset(lane)];
+  double largest = 0;
+  for (int k = 0; k <= count; k++) {
+    largest = std::max(largest, std::fabs(kappa[(first + k) % m]));
+  }
+  return largest;
+}
+
+void LaneCenterlines::ToFrenet(int lane, double x, double y, double s_hint,
+                               double window, double *s, double *d) const {
+  const int m = num_samples_ - 1;
+  const int o = Offset(lane);
+  double f;
+  const int center = Locate(s_hint, &f);
+  const int reach = static_cast<int>(std::ceil(window * inv_step_));
+
+  // Nearest sample.
+  int nearest = center;
+  double nearest_dist2 = -1;
+  for (int k = -reach; k <= reach; k++) {
+    const int i = ((center + k) % m + m) % m;
+    const double dx = x - x_[o + i];
+    const double dy = y - y_[o + i];
+    const double dist2 = dx * dx + dy * dy;
+    if (nearest_dist2 < 0 || dist2 < nearest_dist2) {
+      nearest = i;
+      nearest_dist2 = dist2;
+    }
+  }
+
+  // Project onto the segments on either side of it and keep the closer.
+  double best_dist2 = -1;
+  for (int side = 0; side < 2; side++) {
+    const int i = (side == 0) ? (nearest + m - 1) % m : nearest;
+    const double ax = x_[o + i], ay = y_[o + i];
+    const double ex = x_[o + i + 1] - ax, ey = y_[o + i + 1] - ay;
+    const double px = x - ax, py = y - ay;
+    const double length2 = ex * ex + ey * ey;
+    double t = (length2 > 0) ? (px * ex + py * ey) / length2 : 0;
+    t = std::min(std::max(t, 0.0), 1.0);
+    const double rx = px - t * ex, ry = py - t * ey;
+    const double dist2 = rx * rx + ry * ry;
+    if (best_dist2 < 0 || dist2 < best_dist2) {
+      best_dist2 = dist2;
+      *s = std::fmod((i + t) * step_, max_s_);
+      // Positive cross product is to the left; d grows to the right.
+      const double left =
+          (length2 > 0) ? (ex * py - ey * px) / std::sqrt(length2) : 0;
+      *d = d_[o + i] + t * (d_[o + i + 1] - d_[o + i]) - left;
+    }
+  }
+}
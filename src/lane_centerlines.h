@@ -0,0 +1,57 @@
+#ifndef LANE_CENTERLINES_H_
+#define LANE_CENTERLINES_H_
+
+#include <functional>
+#include <vector>
+
+#include "lane_geometry.h"
+
+// Centre lines of every lane, computed once when the map is loaded. Each
+// lane's centre is sampled every `step` metres of reference s; a sample
+// holds its world position, its d and the curvature. The loop is closed:
+// the last sample of a lane is its first again, one lap of the lane
+// further.
+//
+// Every field is one array with the lanes back to back, sample i of lane l
+// at l * num_samples_ + i, so lane-relative queries (position, curvature
+// ahead, nearest point) are index arithmetic and array reads instead of
+// waypoint searches and trig.
+class LaneCenterlines {
+ public:
+  // Converts Frenet (s, d) to world (x, y).
+  typedef std::function<void(double s, double d, double *x, double *y)> ToXY;
+
+  LaneCenterlines();
+
+  // Samples the centre of every lane of `lanes` about every `step` metres
+  // around the loop.
+  void Build(const LaneGeometry &lanes, double step, const ToXY &to_xy);
+
+  // Centre of `lane` at s, interpolated between samples.
+  void Position(int lane, double s, double *x, double *y) const;
+  // Largest curvature magnitude on `lane` from s to s + distance.
+  double MaxCurvatureAhead(int lane, double s, double distance) const;
+
+  // Frenet coordinates of (x, y) from the nearest point of `lane`'s centre,
+  // searched within `window` metres of s around s_hint.
+  void ToFrenet(int lane, double x, double y, double s_hint, double window,
+                double *s, double *d) const;
+
+ private:
+  int Offset(int lane) const { return lane * num_samples_; }
+  // Sample at or before s, which may lie outside [0, max_s), and the
+  // fraction of the way to the next sample.
+  int Locate(double s, double *f) const;
+
+  double max_s_;
+  double step_;
+  double inv_step_;
+  int num_samples_;  // per lane, the last one closing the loop
+  int num_lanes_;
+
+  std::vector<double> x_, y_;
+  std::vector<double> d_;
+  std::vector<double> curvature_;
+};
+
+#endif  // LANE_CENTERLINES_H_
@@ -0,0 +1,104 @@
+#include "lane_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The lane of every vehicle when the whole road has the same layout. The
+// lane count is a template parameter so common roads get a loop with
+// constant bounds; kLanes == 0 takes it from num_lanes.
+template <int kLanes>
+void AssignUniform(int n, int num_lanes, double lane_width,
+                   const double *__restrict d, int *__restrict lane) {
+  const int lanes = (kLanes > 0) ? kLanes : num_lanes;
+  const double inv_width = 1.0 / lane_width;
+  for (int i = 0; i < n; i++) {
+    // Truncating instead of std::floor() keeps the loop vectorizable;
+    // negative d is off the road either way.
+    const double x = d[i] * inv_width;
+    const int l = static_cast<int>(x);
+    lane[i] = (x >= 0 && l < lanes) ? l : -1;
+  }
+}
+
+}  // namespace
+
+LaneGeometry::LaneGeometry(double max_s)
+    : max_s_(max_s), start_s_(1, 0.0), lanes_(1, 3), width_(1, 4.0),
+      max_lanes_(3), uniform_(true), from_map_(false) {}
+
+void LaneGeometry::AddSegment(double s, int num_lanes, double lane_width) {
+  // The first segment from the map replaces the default layout.
+  if (!from_map_) {
+    start_s_.clear();
+    lanes_.clear();
+    width_.clear();
+    max_lanes_ = 0;
+    from_map_ = true;
+  }
+  if (!lanes_.empty() &&
+      (num_lanes != lanes_.back() || lane_width != width_.back())) {
+    uniform_ = false;
+  }
+  start_s_.push_back(s);
+  lanes_.push_back(num_lanes);
+  width_.push_back(lane_width);
+  max_lanes_ = std::max(max_lanes_, num_lanes);
+}
+
+double LaneGeometry::Wrap(double s) const {
+  s = std::fmod(s, max_s_);
+  return (s < 0) ? s + max_s_ : s;
+}
+
+double LaneGeometry::WrapDelta(double to, double from) const {
+  double ds = std::fmod(to - from, max_s_);
+  if (ds > max_s_ / 2) {
+    ds -= max_s_;
+  } else if (ds < -max_s_ / 2) {
+    ds += max_s_;
+  }
+  return ds;
+}
+
+int LaneGeometry::Segment(double s) const {
+  // Every segment of a uniform road looks like the first.
+  if (uniform_) {
+    return 0;
+  }
+  int segment = static_cast<int>(
+      std::upper_bound(start_s_.begin(), start_s_.end(), Wrap(s)) -
+      start_s_.begin()) - 1;
+  return std::max(segment, 0);
+}
+
+int LaneGeometry::LaneAt(double s, double d) const {
+  const int segment = Segment(s);
+  const int lane = static_cast<int>(std::floor(d / width_[segment]));
+  return (lane >= 0 && lane < lanes_[segment]) ? lane : -1;
+}
+
+void LaneGeometry::AssignLanes(int n, const double *s, const double *d,
+                               int *lane) const {
+  if (!uniform_) {
+    for (int i = 0; i < n; i++) {
+      lane[i] = LaneAt(s[i], d[i]);
+    }
+    return;
+  }
+  switch (max_lanes_) {
+    case 2:
+      AssignUniform<2>(n, 2, width_[0], d, lane);
+      break;
+    case 3:
+      AssignUniform<3>(n, 3, width_[0], d, lane);
+      break;
+    case 4:
+      AssignUniform<4>(n, 4, width_[0], d, lane);
+      break;
+    default:
+      AssignUniform<0>(n, max_lanes_, width_[0], d, lane);
+      break;
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef LANE_GEOMETRY_H_
+#define LANE_GEOMETRY_H_
+
+#include <vector>
+
+// Lane layout of the road, read with the map. Lanes are counted from the
+// center line (d = 0) to the right, all of one width within a segment; the
+// number of lanes and their width may change from one waypoint segment to
+// the next. The road is a loop of length max_s, and every planner stage
+// takes s distances and lane lookups from here.
+//
+// Maps without lane data get the simulator's highway: three lanes of 4 m.
+class LaneGeometry {
+ public:
+  explicit LaneGeometry(double max_s);
+
+  // Sets the layout from waypoint `s` to the next waypoint. Waypoints must
+  // be added in order of s.
+  void AddSegment(double s, int num_lanes, double lane_width);
+
+  double max_s() const { return max_s_; }
+  // s wrapped to [0, max_s).
+  double Wrap(double s) const;
+  // Signed s distance from `from` to `to` the short way around the loop.
+  double WrapDelta(double to, double from) const;
+
+  // Most lanes anywhere on the map; per-lane arrays are sized by this.
+  int num_lanes() const { return max_lanes_; }
+  bool uniform() const { return uniform_; }
+
+  int num_lanes_at(double s) const { return lanes_[Segment(s)]; }
+  double lane_width_at(double s) const { return width_[Segment(s)]; }
+  // d of the center of `lane` at s.
+  double Center(int lane, double s) const {
+    return width_[Segment(s)] * (lane + 0.5);
+  }
+  // Lane containing d at s, or -1 off the road.
+  int LaneAt(double s, double d) const;
+
+  // LaneAt() for n vehicles at once.
+  void AssignLanes(int n, const double *s, const double *d, int *lane) const;
+
+ private:
+  // Index of the segment containing s, wrapped around the loop.
+  int Segment(double s) const;
+
+  double max_s_;
+  std::vector<double> start_s_;
+  std::vector<int> lanes_;
+  std::vector<double> width_;
+  int max_lanes_;
+  bool uniform_;
+  bool from_map_;
+};
+
+#endif  // LANE_GEOMETRY_H_
@@ -0,0 +1,55 @@
+#include "lane_index.h"
+
+#include <algorithm>
+
+namespace {
+
+bool EntryBefore(const LaneIndex::Entry &a, const LaneIndex::Entry &b) {
+  return a.s < b.s;
+}
+
+}  // namespace
+
+LaneIndex::LaneIndex(const LaneGeometry &lanes)
+    : geometry_(&lanes),
+      num_lanes_(lanes.num_lanes()),
+      max_s_(lanes.max_s()),
+      lanes_(lanes.num_lanes()) {}
+
+double LaneIndex::Wrap(double s) const { return geometry_->Wrap(s); }
+
+void LaneIndex::Clear() {
+  for (std::vector<Entry> &entries : lanes_) {
+    entries.clear();
+  }
+}
+
+void LaneIndex::Insert(int lane, int id, double s) {
+  if (lane < 0 || lane >= num_lanes_) {
+    return;
+  }
+  Entry entry;
+  entry.s = Wrap(s);
+  entry.id = id;
+  lanes_[lane].push_back(entry);
+}
+
+void LaneIndex::InsertAt(double d, int id, double s) {
+  Insert(geometry_->LaneAt(s, d), id, s);
+}
+
+void LaneIndex::Sort() {
+  for (std::vector<Entry> &entries : lanes_) {
+    std::sort(entries.begin(), entries.end(), EntryBefore);
+  }
+}
+
+int LaneIndex::LowerBound(int lane, double s) const {
+  Entry key;
+  key.s = s;
+  key.id = 0;
+  const std::vector<Entry> &entries = lanes_[lane];
+  return static_cast<int>(
+      std::lower_bound(entries.begin(), entries.end(), key, EntryBefore) -
+      entries.begin());
+}
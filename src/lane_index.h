@@ -0,0 +1,76 @@
+#ifndef LANE_INDEX_H_
+#define LANE_INDEX_H_
+
+#include <vector>
+
+#include "lane_geometry.h"
+
+// Broad phase for neighbour queries: vehicles sorted by s in one list per
+// lane, rebuilt once per tick. Finding the vehicles of a lane within
+// [s0, s1) is a binary search plus a walk over the k hits, instead of a
+// pass over every vehicle for every lane.
+//
+// s is kept wrapped to [0, max_s); ranges that cross the end of the loop
+// are split in two and visited in order of increasing distance from s0.
+class LaneIndex {
+ public:
+  struct Entry {
+    double s;  // wrapped to [0, max_s)
+    int id;    // caller's index of the vehicle
+  };
+
+  // Keeps a pointer to `lanes`, which must outlive the index.
+  explicit LaneIndex(const LaneGeometry &lanes);
+
+  void Clear();
+  // Adds a vehicle to a lane; lanes off the road are ignored. A vehicle may
+  // be added to several lanes.
+  void Insert(int lane, int id, double s);
+  // Adds a vehicle to the lane containing (s, d), if any.
+  void InsertAt(double d, int id, double s);
+  // Sorts the lanes; call after the inserts and before the queries.
+  void Sort();
+
+  // Calls visit(entry, ds) for every vehicle of `lane` with s in [s0, s1),
+  // where ds is its distance ahead of s0, in increasing order of ds.
+  template <typename Visitor>
+  void Visit(int lane, double s0, double s1, Visitor visit) const;
+
+  int num_lanes() const { return num_lanes_; }
+
+ private:
+  double Wrap(double s) const;
+  // First entry of `lane` with s >= the given value.
+  int LowerBound(int lane, double s) const;
+
+  const LaneGeometry *geometry_;
+  int num_lanes_;
+  double max_s_;
+  std::vector<std::vector<Entry> > lanes_;
+};
+
+template <typename Visitor>
+void LaneIndex::Visit(int lane, double s0, double s1, Visitor visit) const {
+  if (lane < 0 || lane >= num_lanes_ || s1 <= s0) {
+    return;
+  }
+  const std::vector<Entry> &entries = lanes_[lane];
+  const int n = static_cast<int>(entries.size());
+  const double start = Wrap(s0);
+  double end = start + (s1 - s0);
+
+  // Up to the end of the loop...
+  int i = LowerBound(lane, start);
+  for (; i < n && entries[i].s < end; i++) {
+    visit(entries[i], entries[i].s - start);
+  }
+  // ...and on from its start if the range crosses it
+  if (end > max_s_) {
+    end -= max_s_;
+    for (i = 0; i < n && entries[i].s < end && entries[i].s < start; i++) {
+      visit(entries[i], entries[i].s + max_s_ - start);
+    }
+  }
+}
+
+#endif  // LANE_INDEX_H_
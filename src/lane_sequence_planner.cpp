@@ -0,0 +1,228 @@
+#include "lane_sequence_planner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+LaneSequenceConfig::LaneSequenceConfig()
+    : step(0.5),
+      num_steps(20),
+      speed_limit(49.5 / 2.24),
+      max_accel(5.0),
+      time_gap(1.0),
+      min_gap(10.0),
+      change_time(2.5),
+      change_cost(0.3),
+      collision_cost(10.0),
+      min_weight(0.1) {}
+
+LaneSequencePlanner::LaneSequencePlanner(const LaneGeometry &lanes,
+                                         const LaneSequenceConfig &config)
+    : lanes_(&lanes),
+      num_lanes_(lanes.num_lanes()),
+      config_(config),
+      num_hypotheses_(0),
+      nodes_((config.num_steps + 1) * num_lanes_),
+      sequence_(config.num_steps + 1),
+      best_sequence_(config.num_steps + 1),
+      first_cost_(num_lanes_),
+      elapsed_ms_(0) {}
+
+void LaneSequencePlanner::SampleTraffic(
+    double time, const TrajectoryPredictor &prediction) {
+  const int n = prediction.num_hypotheses();
+  const int rows = config_.num_steps + 1;
+  num_hypotheses_ = n;
+  traffic_s_.resize(rows * n);
+  traffic_speed_.resize(rows * n);
+  traffic_lane_.resize(rows * n);
+  weight_.resize(n);
+  for (int h = 0; h < n; h++) {
+    weight_[h] = prediction.hypothesis(h).weight;
+  }
+
+  for (int k = 0; k < rows; k++) {
+    // Past the end of the prediction, vehicles keep their last speed and d.
+    const double t = time + k * config_.step;
+    const int step = prediction.StepAt(t);
+    const double beyond = t - step * prediction.step();
+    const double *s = prediction.s_at(step);
+    const double *d = prediction.d_at(step);
+    const double *speed = prediction.speed_at(step);
+    double *row_s = traffic_s_.data() + k * n;
+    for (int h = 0; h < n; h++) {
+      row_s[h] = s[h] + speed[h] * beyond;
+      traffic_speed_[k * n + h] = speed[h];
+    }
+    lanes_->AssignLanes(n, row_s, d, traffic_lane_.data() + k * n);
+  }
+}
+
+double LaneSequencePlanner::LaneSpeed(int step, int lane, double s,
+                                      double speed) const {
+  const int n = num_hypotheses_;
+  const double *traffic_s = traffic_s_.data() + step * n;
+  const double *traffic_speed = traffic_speed_.data() + step * n;
+  const int *traffic_lane = traffic_lane_.data() + step * n;
+
+  double limit = config_.speed_limit;
+  for (int h = 0; h < n; h++) {
+    if (traffic_lane[h] != lane || weight_[h] < config_.min_weight) {
+      continue;
+    }
+    const double ds = lanes_->WrapDelta(traffic_s[h], s);
+    // Close enough to follow by the end of the step
+    const double follow = config_.min_gap + config_.time_gap * speed +
+                          (speed - traffic_speed[h]) * config_.step;
+    if (ds > 0 && ds < follow && traffic_speed[h] < limit) {
+      limit = traffic_speed[h];
+    }
+  }
+  return limit;
+}
+
+double LaneSequencePlanner::GapRisk(int step, int lane, double s,
+                                    double speed) const {
+  const int n = num_hypotheses_;
+  const double *traffic_s = traffic_s_.data() + step * n;
+  const double *traffic_speed = traffic_speed_.data() + step * n;
+  const int *traffic_lane = traffic_lane_.data() + step * n;
+
+  double risk = 0;
+  for (int h = 0; h < n; h++) {
+    if (traffic_lane[h] != lane || weight_[h] < config_.min_weight) {
+      continue;
+    }
+    // The gap has to cover what the faster of the two closes in time_gap.
+    const double ds = lanes_->WrapDelta(traffic_s[h], s);
+    const double closing = (ds >= 0) ? speed - traffic_speed[h]
+                                     : traffic_speed[h] - speed;
+    const double needed =
+        config_.min_gap + std::max(0.0, closing) * config_.time_gap;
+    if (std::fabs(ds) < needed) {
+      risk += weight_[h];
+    }
+  }
+  return std::min(risk, 1.0);
+}
+
+double LaneSequencePlanner::Run(int lane, double s, double speed,
+                                int first_lane, std::vector<int> &sequence) {
+  const double infinity = std::numeric_limits<double>::infinity();
+  const int num_lanes = num_lanes_;
+  const int num_steps = config_.num_steps;
+  const int change_steps =
+      static_cast<int>(std::ceil(config_.change_time / config_.step));
+  const double max_dv = config_.max_accel * config_.step;
+
+  for (Node &node : nodes_) {
+    node.cost = infinity;
+  }
+  Node &start = nodes_[lane];
+  start.cost = 0;
+  start.s = s;
+  start.speed = speed;
+  start.last_change = -change_steps;
+  start.parent = -1;
+
+  for (int k = 0; k < num_steps; k++) {
+    const Node *from_row = &nodes_[k * num_lanes];
+    Node *to_row = &nodes_[(k + 1) * num_lanes];
+    for (int l = 0; l < num_lanes; l++) {
+      if (k == 0 && l != first_lane) {
+        continue;
+      }
+      // Keeping the lane is tried first so it wins ties.
+      const int parents[3] = {l, l - 1, l + 1};
+      for (int p : parents) {
+        if (p < 0 || p >= num_lanes || from_row[p].cost == infinity) {
+          continue;
+        }
+        const Node &from = from_row[p];
+        const bool change = (p != l);
+        if (change && k - from.last_change < change_steps) {
+          continue;
+        }
+
+        // While changing, the car in front on both lanes counts.
+        double target = LaneSpeed(k, l, from.s, from.speed);
+        if (change) {
+          target = std::min(target, LaneSpeed(k, p, from.s, from.speed));
+        }
+        double v = std::max(from.speed - max_dv,
+                            std::min(from.speed + max_dv, target));
+        v = std::max(v, 0.0);
+        const double mean_speed = (from.speed + v) / 2;
+        const double next_s = from.s + mean_speed * config_.step;
+        if (l >= lanes_->num_lanes_at(next_s)) {
+          continue;
+        }
+
+        double cost = from.cost + (config_.speed_limit - mean_speed) /
+                                      config_.speed_limit * config_.step;
+        if (change) {
+          double risk = std::max(GapRisk(k, l, from.s, from.speed),
+                                 GapRisk(k + 1, l, next_s, v));
+          cost += config_.change_cost + config_.collision_cost * risk;
+        }
+
+        Node &to = to_row[l];
+        if (cost < to.cost) {
+          to.cost = cost;
+          to.s = next_s;
+          to.speed = v;
+          to.last_change = change ? k : from.last_change;
+          to.parent = p;
+        }
+      }
+    }
+  }
+
+  // Cheapest end, then back along the parents
+  const Node *last_row = &nodes_[num_steps * num_lanes];
+  int end = 0;
+  for (int l = 1; l < num_lanes; l++) {
+    end = (last_row[l].cost < last_row[end].cost) ? l : end;
+  }
+  const double cost = last_row[end].cost;
+  if (cost == infinity) {
+    return cost;
+  }
+  for (int k = num_steps; k >= 0; k--) {
+    sequence[k] = end;
+    end = nodes_[k * num_lanes + end].parent;
+  }
+  return cost;
+}
+
+void LaneSequencePlanner::Plan(int lane, double s, double speed, double time,
+                               const TrajectoryPredictor &prediction) {
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+  const double infinity = std::numeric_limits<double>::infinity();
+
+  SampleTraffic(time, prediction);
+
+  double best_cost = infinity;
+  for (int l = 0; l < num_lanes_; l++) {
+    first_cost_[l] = infinity;
+  }
+  const int first_lanes[3] = {lane, lane - 1, lane + 1};
+  for (int first : first_lanes) {
+    if (first < 0 || first >= lanes_->num_lanes_at(s)) {
+      continue;
+    }
+    first_cost_[first] = Run(lane, s, speed, first, sequence_);
+    if (first_cost_[first] < best_cost) {
+      best_cost = first_cost_[first];
+      best_sequence_ = sequence_;
+    }
+  }
+  if (best_cost == infinity) {
+    best_sequence_.assign(config_.num_steps + 1, lane);
+  }
+
+  elapsed_ms_ = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                          start).count();
+}
@@ -0,0 +1,103 @@
+#ifndef LANE_SEQUENCE_PLANNER_H_
+#define LANE_SEQUENCE_PLANNER_H_
+
+#include <vector>
+
+#include "lane_geometry.h"
+#include "prediction.h"
+
+struct LaneSequenceConfig {
+  LaneSequenceConfig();
+
+  // The lattice: num_steps steps of `step` seconds.
+  double step;
+  int num_steps;
+  double speed_limit;  // m/s
+  // Speed changes by at most this much per second, up or down.
+  double max_accel;
+  // Following: at closer than min_gap + time_gap * speed we drop to the
+  // speed of the car in front.
+  double time_gap;
+  double min_gap;
+  // A lane change takes this long; the next one cannot start before.
+  double change_time;
+  // Cost of one lane change, in seconds of standing still.
+  double change_cost;
+  // Cost of a lane change into a gap that is too short, per unit of the
+  // weight of the hypotheses in the way.
+  double collision_cost;
+  // Hypotheses less likely than this are ignored.
+  double min_weight;
+};
+
+// Plans which lanes to drive in over the next few seconds. Dynamic
+// programming over a lane x time lattice: at every step the car either
+// keeps its lane or moves one lane over, drives as fast as the predicted
+// traffic in front of it allows, and pays for the speed it loses, for lane
+// changes and for changing into short gaps. Unlike the state machine, which
+// only looks at its neighbours, this finds sequences like two lane changes
+// to reach a free lane on the far side.
+//
+// Each node keeps only the best way to reach it, carrying the position and
+// speed of the car along, so one pass costs steps x lanes x 3 edges, each
+// checked against the hypotheses of that step.
+class LaneSequencePlanner {
+ public:
+  // Plans on the lanes of `lanes`, which must outlive the planner; a node
+  // is only reachable where its lane exists.
+  LaneSequencePlanner(const LaneGeometry &lanes,
+                      const LaneSequenceConfig &config);
+
+  // Plans from the ego car on `lane` at s with `speed` m/s, `time` seconds
+  // after the start of the prediction. Runs once per possible first move:
+  // keeping the lane, or one lane to the left or right.
+  void Plan(int lane, double s, double speed, double time,
+            const TrajectoryPredictor &prediction);
+
+  // Cost of the best sequence whose first move is to `lane`; infinite for
+  // lanes that cannot be reached in one move.
+  double cost(int lane) const { return first_cost_[lane]; }
+  // Lane at every step of the best sequence overall; step 0 is now.
+  const std::vector<int> &sequence() const { return best_sequence_; }
+  double elapsed_ms() const { return elapsed_ms_; }
+
+ private:
+  // Node of the lattice: the best way found to be on a lane at a step.
+  struct Node {
+    double cost;
+    double s;
+    double speed;
+    int last_change;  // step the last lane change started
+    int parent;       // lane at the previous step
+  };
+
+  // Samples the predicted traffic at every step of the lattice.
+  void SampleTraffic(double time, const TrajectoryPredictor &prediction);
+  // Fills the lattice with the first move forced to first_lane and returns
+  // the cost of the best sequence, writing it to `sequence`.
+  double Run(int lane, double s, double speed, int first_lane,
+             std::vector<int> &sequence);
+  // Speed we can hold on `lane` at `step` from s, given the car in front.
+  double LaneSpeed(int step, int lane, double s, double speed) const;
+  // Weight of the hypotheses in the way of moving into `lane` at s.
+  double GapRisk(int step, int lane, double s, double speed) const;
+
+  const LaneGeometry *lanes_;
+  int num_lanes_;
+  LaneSequenceConfig config_;
+
+  // Traffic per step, num_steps + 1 rows of num_hypotheses entries.
+  int num_hypotheses_;
+  std::vector<double> traffic_s_;
+  std::vector<double> traffic_speed_;
+  std::vector<int> traffic_lane_;  // -1 off the road
+  std::vector<double> weight_;     // per hypothesis
+
+  std::vector<Node> nodes_;  // (num_steps + 1) x num_lanes
+  std::vector<int> sequence_;
+  std::vector<int> best_sequence_;
+  std::vector<double> first_cost_;
+  double elapsed_ms_;
+};
+
+#endif  // LANE_SEQUENCE_PLANNER_H_
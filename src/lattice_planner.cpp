@@ -0,0 +1,306 @@
+#include "lattice_planner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Jerk (m/s^3) at which the comfort cost reaches 1 - 1/e.
+const double kComfortJerk = 2.0;
+// Time between the points of the simulator's path.
+const double kPathStep = 0.02;
+// Extent of the occupancy grid along s around the ego vehicle, metres.
+const double kGridBehind = 100;
+const double kGridAhead = 300;
+
+}  // namespace
+
+LatticeConfig::LatticeConfig()
+    : speed_limit(49.5 / 2.24),
+      max_accel(7.0),
+      speed_fractions({1.0, 0.9, 0.8, 0.7, 0.55, 0.4, 0.2}),
+      horizons({2.0, 3.0, 4.0}),
+      eval_time(4.0),
+      eval_step(0.1),
+      car_length(5.0),
+      car_width(2.5),
+      time_gap(1.2),
+      weight_collision(10.0),
+      weight_jerk(1.0),
+      weight_speed(1.0),
+      weight_efficiency(2.0),
+      deadline_ms(5.0),
+      anytime(false),
+      max_refine_rounds(4),
+      batch_size(16) {}
+
+LatticePlanner::LatticePlanner(ThreadPool *pool, const LaneGeometry &lanes,
+                               const LatticeConfig &config)
+    : pool_(pool), lanes_(&lanes), config_(config),
+      obstacle_index_(lanes),
+      occupancy_(lanes, 1.0, kGridBehind, kGridAhead,
+                 std::max(1, static_cast<int>(std::round(config.eval_step /
+                                                         kPathStep)))),
+      best_(), num_candidates_(0), num_evaluated_(0), num_refine_rounds_(0),
+      elapsed_ms_(0), num_plans_(0), num_deadline_hits_(0) {}
+
+void LatticePlanner::GenerateCandidates(const EgoState &ego) {
+  candidates_.clear();
+
+  const double lane_width = lanes_->lane_width_at(ego.s);
+  const int num_lanes = lanes_->num_lanes_at(ego.s);
+  int ego_lane =
+      static_cast<int>(std::round((ego.d - lane_width / 2) / lane_width));
+  ego_lane = std::max(0, std::min(num_lanes - 1, ego_lane));
+
+  // Keeping the lane at the current speed is always feasible, so it goes
+  // first and there is a fallback even if the deadline hits immediately.
+  Candidate keep = Candidate();
+  keep.lane = ego_lane;
+  keep.target_speed = ego.speed;
+  keep.horizon = config_.horizons.front();
+  candidates_.push_back(keep);
+
+  // Only the current and adjacent lanes are sampled.
+  for (int lane = ego_lane - 1; lane <= ego_lane + 1; lane++) {
+    if (lane < 0 || lane >= num_lanes) {
+      continue;
+    }
+    for (double fraction : config_.speed_fractions) {
+      for (double horizon : config_.horizons) {
+        Candidate candidate = Candidate();
+        candidate.lane = lane;
+        candidate.target_speed = fraction * config_.speed_limit;
+        candidate.horizon = horizon;
+        candidates_.push_back(candidate);
+      }
+    }
+  }
+
+  // Most promising first: staying in the lane, then high target speeds.
+  std::stable_sort(
+      candidates_.begin() + 1, candidates_.end(),
+      [ego_lane, this](const Candidate &a, const Candidate &b) {
+        double priority_a = (a.lane != ego_lane) +
+                            (config_.speed_limit - a.target_speed) /
+                                config_.speed_limit;
+        double priority_b = (b.lane != ego_lane) +
+                            (config_.speed_limit - b.target_speed) /
+                                config_.speed_limit;
+        return priority_a < priority_b;
+      });
+}
+
+void LatticePlanner::GenerateRefinements(const Candidate &best, int round) {
+  const double scale = 1.0 / (1 << round);
+  const double speed_step = 0.05 * config_.speed_limit * scale;
+  const double horizon_step = 0.5 * scale;
+
+  for (int i = -1; i <= 1; i++) {
+    for (int j = -1; j <= 1; j++) {
+      if (i == 0 && j == 0) {
+        continue;
+      }
+      Candidate candidate = Candidate();
+      candidate.lane = best.lane;
+      candidate.target_speed =
+          std::max(0.0, std::min(config_.speed_limit,
+                                 best.target_speed + i * speed_step));
+      candidate.horizon = std::max(1.0, best.horizon + j * horizon_step);
+      candidates_.push_back(candidate);
+    }
+  }
+}
+
+void LatticePlanner::Evaluate(const EgoState &ego,
+                              const std::vector<Obstacle> &obstacles,
+                              const TrajectoryPredictor &prediction,
+                              Candidate &candidate) const {
+  const double infinity = std::numeric_limits<double>::infinity();
+  const double T = candidate.horizon;
+  const double v0 = ego.speed;
+  const double v1 = candidate.target_speed;
+  const double dv = v1 - v0;
+  const double lane_d = lanes_->Center(candidate.lane, ego.s);
+  const double dd = lane_d - ego.d;
+
+  // Longitudinally a quartic that changes speed from v0 to v1 and laterally
+  // a quintic that moves from ego.d to the lane center, both ending with zero
+  // acceleration at t = T. Peak longitudinal acceleration is 1.5 dv / T.
+  if (1.5 * std::fabs(dv) / T > config_.max_accel) {
+    candidate.cost = infinity;
+    return;
+  }
+
+  // Closed-form integrals of the squared jerk of both polynomials,
+  // averaged over the evaluation window.
+  double mean_sq_jerk = (12 * dv * dv / (T * T * T) +
+                         720 * dd * dd / (T * T * T * T * T)) /
+                        config_.eval_time;
+  candidate.cost_jerk =
+      1 - std::exp(-mean_sq_jerk / (kComfortJerk * kComfortJerk));
+
+  if (v1 > config_.speed_limit) {
+    candidate.cost_speed = 1;
+  } else {
+    candidate.cost_speed = (config_.speed_limit - v1) / config_.speed_limit;
+  }
+
+  // Efficiency: the speed we can actually hold in the target lane is capped
+  // by the slowest vehicle ahead of us within the look-ahead distance.
+  double lane_speed = config_.speed_limit;
+  double look_ahead = config_.speed_limit * config_.eval_time;
+  obstacle_index_.Visit(
+      candidate.lane, ego.s, ego.s + look_ahead,
+      [&](const LaneIndex::Entry &entry, double ds) {
+        if (ds > 0) {
+          lane_speed = std::min(lane_speed, obstacles[entry.id].speed_s);
+        }
+      });
+  candidate.cost_efficiency =
+      1 - std::min(v1, lane_speed) / config_.speed_limit;
+
+  // Collision: walk the evaluation window and keep the worst proximity to
+  // any predicted vehicle sharing our lateral band. Overlap costs 1, a gap
+  // beyond time_gap seconds costs 0; a vehicle's risk is the expectation
+  // over its weighted hypotheses.
+  double risk = 0;
+  const double s_T = v0 * T + dv * T / 2;
+  for (double t = config_.eval_step; t <= config_.eval_time + 1e-9 && risk < 1;
+       t += config_.eval_step) {
+    double tau = std::min(t / T, 1.0);
+    double tau3 = tau * tau * tau;
+    double s, v;
+    if (t < T) {
+      s = v0 * t + dv * T * (tau3 * tau - tau3 * tau * tau / 2);
+      v = v0 + dv * (3 * tau * tau - 2 * tau3);
+    } else {
+      s = s_T + v1 * (t - T);
+      v = v1;
+    }
+    double d = ego.d + dd * tau3 * (10 - 15 * tau + 6 * tau * tau);
+
+    // Nobody is near enough to cost anything here
+    if (!occupancy_.Occupied(ego.time + t, ego.s + s, d)) {
+      continue;
+    }
+
+    const int step = prediction.StepAt(ego.time + t);
+    const double *obstacle_s = prediction.s_at(step);
+    const double *obstacle_d = prediction.d_at(step);
+    const double *obstacle_v = prediction.speed_at(step);
+    for (int vehicle = 0; vehicle < prediction.num_vehicles(); vehicle++) {
+      double vehicle_risk = 0;
+      for (int h = prediction.vehicle_begin(vehicle);
+           h < prediction.vehicle_begin(vehicle + 1); h++) {
+        if (std::fabs(obstacle_d[h] - d) >= config_.car_width) {
+          continue;
+        }
+        double ds = lanes_->WrapDelta(obstacle_s[h], ego.s + s);
+        double gap = std::fabs(ds) - config_.car_length;
+        double r = 0;
+        if (gap <= 0) {
+          r = 1;
+        } else {
+          double safe_gap = config_.time_gap * std::max(v, obstacle_v[h]);
+          if (gap < safe_gap) {
+            r = 1 - gap / safe_gap;
+          }
+        }
+        vehicle_risk += prediction.hypothesis(h).weight * r * r;
+      }
+      risk = std::max(risk, vehicle_risk);
+    }
+  }
+  candidate.cost_collision = risk;
+
+  candidate.cost = config_.weight_collision * candidate.cost_collision +
+                   config_.weight_jerk * candidate.cost_jerk +
+                   config_.weight_speed * candidate.cost_speed +
+                   config_.weight_efficiency * candidate.cost_efficiency;
+}
+
+bool LatticePlanner::EvaluateRange(const EgoState &ego,
+                                   const std::vector<Obstacle> &obstacles,
+                                   const TrajectoryPredictor &prediction,
+                                   int first, Clock::time_point deadline) {
+  const int end = static_cast<int>(candidates_.size());
+  for (int batch = first; batch < end; batch += config_.batch_size) {
+    if (Clock::now() > deadline) {
+      return false;
+    }
+    int batch_end = std::min(end, batch + config_.batch_size);
+    pool_->ParallelFor(batch, batch_end, [&](int i) {
+      Evaluate(ego, obstacles, prediction, candidates_[i]);
+    });
+    num_evaluated_ += batch_end - batch;
+
+    for (int i = batch; i < batch_end; i++) {
+      if (candidates_[i].cost < best_.cost) {
+        best_ = candidates_[i];
+      }
+    }
+  }
+  return true;
+}
+
+Candidate LatticePlanner::Plan(const EgoState &ego,
+                               const std::vector<Obstacle> &obstacles,
+                               const TrajectoryPredictor &prediction) {
+  return Plan(ego, obstacles, prediction, Clock::now());
+}
+
+Candidate LatticePlanner::Plan(const EgoState &ego,
+                               const std::vector<Obstacle> &obstacles,
+                               const TrajectoryPredictor &prediction,
+                               Clock::time_point received) {
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point deadline =
+      received + std::chrono::microseconds(
+                     static_cast<long>(config_.deadline_ms * 1000));
+
+  num_evaluated_ = 0;
+  num_refine_rounds_ = 0;
+  GenerateCandidates(ego);
+  obstacle_index_.Clear();
+  for (int i = 0; i < static_cast<int>(obstacles.size()); i++) {
+    obstacle_index_.InsertAt(obstacles[i].d, i, obstacles[i].s);
+  }
+  obstacle_index_.Sort();
+  // Rasterize the traffic once; cells are marked as far out as any gap can
+  // still cost, so points on free cells skip the exact check.
+  occupancy_.Build(prediction, ego.s, config_.car_length, config_.time_gap,
+                   std::max(config_.speed_limit, ego.speed),
+                   config_.car_width / 2);
+
+  // The fallback is scored outside the deadline so there is always an
+  // answer with a valid cost.
+  Evaluate(ego, obstacles, prediction, candidates_[0]);
+  best_ = candidates_[0];
+  num_evaluated_ = 1;
+
+  bool complete = EvaluateRange(ego, obstacles, prediction, 1, deadline);
+
+  if (config_.anytime) {
+    while (complete && num_refine_rounds_ < config_.max_refine_rounds &&
+           best_.cost < std::numeric_limits<double>::infinity()) {
+      int first = static_cast<int>(candidates_.size());
+      GenerateRefinements(best_, num_refine_rounds_);
+      complete = EvaluateRange(ego, obstacles, prediction, first, deadline);
+      if (complete) {
+        num_refine_rounds_++;
+      }
+    }
+  }
+
+  num_plans_++;
+  if (!complete) {
+    num_deadline_hits_++;
+  }
+  num_candidates_ = static_cast<int>(candidates_.size());
+  elapsed_ms_ = std::chrono::duration<double, std::milli>(Clock::now() - start)
+                    .count();
+  return best_;
+}
@@ -0,0 +1,146 @@
+#ifndef LATTICE_PLANNER_H_
+#define LATTICE_PLANNER_H_
+
+#include <chrono>
+#include <vector>
+
+#include "lane_geometry.h"
+#include "lane_index.h"
+#include "occupancy_grid.h"
+#include "prediction.h"
+#include "thread_pool.h"
+
+// Ego state at the end of the already committed path, in Frenet coordinates.
+struct EgoState {
+  double s;
+  double d;
+  double speed;  // m/s
+  double time;   // s after the start of the traffic prediction
+};
+
+// Another vehicle as seen by the planner, predicted forward to the same
+// instant as the ego state.
+struct Obstacle {
+  double s;
+  double d;
+  double speed_s;  // m/s along the road
+  double speed_d;  // m/s across the road
+  double accel_s;  // m/s^2 along the road
+};
+
+// One sample of the lattice: drive towards `lane` reaching `target_speed`
+// after `horizon` seconds. The cost fields are filled in by the planner.
+struct Candidate {
+  int lane;
+  double target_speed;  // m/s
+  double horizon;       // s
+  double cost;
+  double cost_collision;
+  double cost_jerk;
+  double cost_speed;
+  double cost_efficiency;
+};
+
+struct LatticeConfig {
+  LatticeConfig();
+
+  double speed_limit;  // m/s
+  double max_accel;    // m/s^2, longitudinal
+  // Target speeds sampled, as fractions of speed_limit.
+  std::vector<double> speed_fractions;
+  // Maneuver durations sampled, in seconds.
+  std::vector<double> horizons;
+  // All candidates are scored over the same window so costs are comparable.
+  double eval_time;
+  double eval_step;
+  double car_length;
+  double car_width;
+  // Time gap kept to other vehicles before the collision cost saturates.
+  double time_gap;
+  double weight_collision;
+  double weight_jerk;
+  double weight_speed;
+  double weight_efficiency;
+  // Wall-clock budget in milliseconds, counted from the receipt of the
+  // telemetry message; candidates not scored in time are dropped.
+  double deadline_ms;
+  // Anytime mode: after the lattice, keep refining around the best
+  // candidate with finer speed/horizon steps until the deadline is hit or
+  // max_refine_rounds are done.
+  bool anytime;
+  int max_refine_rounds;
+  // Candidates are scored in batches of this size, in priority order, and
+  // the deadline is checked between batches.
+  int batch_size;
+};
+
+// Sampling-based planner stage. Each tick it builds a lattice of candidate
+// maneuvers (lane x target speed x horizon) around the ego state, scores
+// them against the predicted traffic in parallel and returns the cheapest.
+//
+// Planning is anytime: candidates are scored most promising first and the
+// best one found so far is returned when the deadline is reached.
+class LatticePlanner {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  // Samples the lanes of `lanes`, which must outlive the planner.
+  LatticePlanner(ThreadPool *pool, const LaneGeometry &lanes,
+                 const LatticeConfig &config);
+
+  // Plans with a deadline of config.deadline_ms from now. Collisions are
+  // checked against the predicted trajectories; the obstacles only set the
+  // speed each lane can be driven at.
+  Candidate Plan(const EgoState &ego, const std::vector<Obstacle> &obstacles,
+                 const TrajectoryPredictor &prediction);
+  // Plans with the deadline counted from `received`, the time the telemetry
+  // message arrived.
+  Candidate Plan(const EgoState &ego, const std::vector<Obstacle> &obstacles,
+                 const TrajectoryPredictor &prediction,
+                 Clock::time_point received);
+
+  // Statistics of the last Plan() call.
+  int num_candidates() const { return num_candidates_; }
+  int num_evaluated() const { return num_evaluated_; }
+  int num_refine_rounds() const { return num_refine_rounds_; }
+  double elapsed_ms() const { return elapsed_ms_; }
+
+  // Counters over all Plan() calls.
+  long num_plans() const { return num_plans_; }
+  // Calls that returned because the deadline was reached rather than
+  // because all work was done.
+  long num_deadline_hits() const { return num_deadline_hits_; }
+
+ private:
+  void GenerateCandidates(const EgoState &ego);
+  // Appends candidates around `best` in the same lane, with speed and
+  // horizon steps that shrink with every round.
+  void GenerateRefinements(const Candidate &best, int round);
+  void Evaluate(const EgoState &ego, const std::vector<Obstacle> &obstacles,
+                const TrajectoryPredictor &prediction,
+                Candidate &candidate) const;
+  // Scores candidates_[first, end) batch by batch and updates best_.
+  // Returns false if the deadline stopped it early.
+  bool EvaluateRange(const EgoState &ego,
+                     const std::vector<Obstacle> &obstacles,
+                     const TrajectoryPredictor &prediction, int first,
+                     Clock::time_point deadline);
+
+  ThreadPool *pool_;
+  const LaneGeometry *lanes_;
+  LatticeConfig config_;
+  // Obstacles by lane and s, and predicted traffic rasterized, per Plan()
+  // call.
+  LaneIndex obstacle_index_;
+  OccupancyGrid occupancy_;
+  std::vector<Candidate> candidates_;
+  Candidate best_;
+  int num_candidates_;
+  int num_evaluated_;
+  int num_refine_rounds_;
+  double elapsed_ms_;
+  long num_plans_;
+  long num_deadline_hits_;
+};
+
+#endif  // LATTICE_PLANNER_H_
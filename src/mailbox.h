@@ -0,0 +1,49 @@
+#ifndef MAILBOX_H_
+#define MAILBOX_H_
+
+#include <atomic>
+#include <memory>
+
+// Single-slot, latest-value mailbox between two threads. Posting replaces
+// whatever is still waiting, so a slow reader always gets the newest value
+// and never a backlog. Both sides are a single atomic exchange.
+template <typename T>
+class Mailbox {
+ public:
+  Mailbox() : slot_(nullptr), num_dropped_(0) {}
+  ~Mailbox() { delete slot_.exchange(nullptr); }
+
+  Mailbox(const Mailbox &) = delete;
+  Mailbox &operator=(const Mailbox &) = delete;
+
+  // Returns true if an unread value had to be dropped.
+  bool Post(std::unique_ptr<T> value) {
+    T *old = slot_.exchange(value.release(), std::memory_order_acq_rel);
+    if (old == nullptr) {
+      return false;
+    }
+    delete old;
+    num_dropped_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Returns the waiting value, or nullptr if there is none.
+  std::unique_ptr<T> Take() {
+    return std::unique_ptr<T>(
+        slot_.exchange(nullptr, std::memory_order_acq_rel));
+  }
+
+  bool Empty() const {
+    return slot_.load(std::memory_order_acquire) == nullptr;
+  }
+
+  long num_dropped() const {
+    return num_dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<T *> slot_;
+  std::atomic<long> num_dropped_;
+};
+
+#endif  // MAILBOX_H_
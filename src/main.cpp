@@ -1,14 +1,36 @@
 #include <fstream>
 #include <math.h>
 #include <uWS/uWS.h>
+#include <uv.h>
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
 #include "Eigen-3.3/Eigen/QR"
 #include "json.hpp"
-#include "spline.h"
+#include "behavior_cost.h"
+#include "behavior_fsm.h"
+#include "frenet_projector.h"
+#include "intent_classifier.h"
+#include "kalman_bank.h"
+#include "lane_centerlines.h"
+#include "lane_geometry.h"
+#include "lane_index.h"
+#include "lane_sequence_planner.h"
+#include "lattice_planner.h"
+#include "motion_primitives.h"
+#include "oriented_box.h"
+#include "path_reuse.h"
+#include "pose2d.h"
+#include "planning_worker.h"
+#include "prediction.h"
+#include "speed_profile.h"
+#include "thread_pool.h"
+#include "tracker.h"
 
 using namespace std;
 
@@ -21,22 +43,6 @@ double deg2rad(double x) { return x * pi() / 180; }
 double rad2deg(double x) { return x * 180 / pi(); }
 
 
-int indexofSmallestElement(vector<double>& array, int size)
-{
-  int index = 0 ;
-  double n = array[0] ;
-  for (int i = 1; i < size; ++i)
-  {
-    if (array[i] < n)
-    {
-        n = array[i] ;
-        index = i ;
-    }
-  }
- return index;
-}
-
-
 // Checks if the SocketIO event has JSON data.
 // If there is data the JSON object in string format will be returned,
 // else the empty string "" will be returned.
@@ -62,7 +68,7 @@ int ClosestWaypoint(double x, double y, const vector<double> &maps_x, const vect
 	double closestLen = 100000; //large number
 	int closestWaypoint = 0;
 
-	for(int i = 0; i < maps_x.size(); i++)
+	for(int i = 0; i < (int)maps_x.size(); i++)
 	{
 		double map_x = maps_x[i];
 		double map_y = maps_y[i];
@@ -95,7 +101,7 @@ int NextWaypoint(double x, double y, double theta, const vector<double> &maps_x,
   if(angle > pi()/4)
   {
     closestWaypoint++;
-  if (closestWaypoint == maps_x.size())
+  if (closestWaypoint == (int)maps_x.size())
   {
     closestWaypoint = 0;
   }
@@ -158,10 +164,15 @@ vector<double> getXY(double s, double d, const vector<double> &maps_s, const vec
 {
 	int prev_wp = -1;
 
-	while(s > maps_s[prev_wp+1] && (prev_wp < (int)(maps_s.size()-1) ))
+	while(prev_wp < (int)(maps_s.size()-1) && s > maps_s[prev_wp+1])
 	{
 		prev_wp++;
 	}
+	// s at or before the first waypoint lies on the first segment
+	if(prev_wp<0)
+	{
+		prev_wp=0;
+	}
 
 	int wp2 = (prev_wp+1)%maps_x.size();
 
@@ -181,85 +192,295 @@ vector<double> getXY(double s, double d, const vector<double> &maps_s, const vec
 
 }
 
-int main() {
-  uWS::Hub h;
-
-  // Load up map values for waypoint's x,y,s and d normalized normal vectors
-  vector<double> map_waypoints_x;
-  vector<double> map_waypoints_y;
-  vector<double> map_waypoints_s;
-  vector<double> map_waypoints_dx;
-  vector<double> map_waypoints_dy;
+// Behavior planners selectable from the command line
+enum PlannerMode { kStateMachine, kLatticePlanner };
+
+// Sensor fusion data of one tick, one array per field
+struct SensorFusionBatch {
+  void Resize(int n) {
+    s.resize(n);
+    d.resize(n);
+    vx.resize(n);
+    vy.resize(n);
+    speed_s.resize(n);
+    speed_d.resize(n);
+    lane.resize(n);
+  }
 
-  // Waypoint map to read from
-  string map_file_ = "../data/highway_map.csv";
-  // The max s value before wrapping around the track back to 0
-  double max_s = 6945.554;
+  vector<double> s;
+  vector<double> d;
+  vector<double> vx;
+  vector<double> vy;
+  // Velocity along and across the road
+  vector<double> speed_s;
+  vector<double> speed_d;
+  // Lane of each car, -1 off the road
+  vector<int> lane;
+};
+
+// The path of the last tick, in the frame of the path end it was fitted
+// at. While it still leads to the same lane the next ticks extend it
+// instead of fitting a new one.
+struct FittedPath {
+  FittedPath()
+      : valid(false), lane(-1), primitive(NULL), pose(0, 0, 0), x(0),
+        target_dist(1), end_x(0), end_y(0), num_fits(0), num_extensions(0) {}
+
+  bool valid;
+  int lane;
+  const MotionPrimitive *primitive;
+  Pose2D pose;
+  double anchor_y[MotionPrimitive::kNumAnchors];
+  // x of the last point sampled, and the walkthrough's distance to x = 30
+  double x;
+  double target_dist;
+  // Last point sent, to see whether the simulator still follows this path
+  double end_x;
+  double end_y;
+  int num_fits;
+  int num_extensions;
+};
+
+// Planner state of one simulator connection, carried over from one
+// telemetry message to the next
+struct PlannerState {
+  // Set staring velocity, starting lane and starting state
+  PlannerState(ThreadPool *pool, const LatticeConfig &lattice_config,
+               const IntentClassifier *intent_classifier,
+               const BehaviorCostModel &behavior_costs,
+               const LaneGeometry *lanes)
+      : ref_vel(1), speed_profile(SpeedProfileConfig(), ref_vel / 2.24),
+        lane(1), current_state(0), behavior_costs(behavior_costs),
+        lattice_planner(pool, *lanes, lattice_config), lanes(lanes),
+        kalman(tracker.max_tracks(), lanes->max_s()),
+        intent_classifier(intent_classifier), p_keep(tracker.max_tracks()),
+        p_left(tracker.max_tracks()), p_right(tracker.max_tracks()),
+        prediction(*lanes, PredictionConfig()), lane_index(*lanes),
+        lane_sequence(*lanes, LaneSequenceConfig()),
+        path_reuse(PathReuseConfig()), decided_lane(-1), decided_speed(0),
+        time(0), sent_size(0) {}
+
+  // Speed at the end of the path sent, in mph, and the plan it follows
+  double ref_vel;
+  SpeedProfile speed_profile;
+  int lane;
+  int current_state;
+  BehaviorFsm fsm;
+  // Scores the state machine's transitions; copied per connection since it
+  // keeps traces
+  BehaviorCostModel behavior_costs;
+  BehaviorCandidates behavior_candidates;
+  LaneTraffic lane_traffic;
+  LatticePlanner lattice_planner;
+  // Lane layout of the map
+  const LaneGeometry *lanes;
+
+  // Tracks of the other vehicles and their filtered Frenet states, timed by
+  // the session clock: seconds of path the simulator has driven, counted
+  // from the points it consumed.
+  Tracker tracker;
+  KalmanFilterBank kalman;
+  // Lane-change intent of every track, indexed like the tracks
+  const IntentClassifier *intent_classifier;
+  vector<double> p_keep;
+  vector<double> p_left;
+  vector<double> p_right;
+  // Weighted future trajectories of the other vehicles
+  vector<VehicleEstimate> vehicle_estimates;
+  TrajectoryPredictor prediction;
+  // Cars sorted by predicted s per lane, with their predicted s, d and speed
+  LaneIndex lane_index;
+  vector<double> check_s;
+  vector<double> check_d;
+  vector<double> check_v;
+  // Lane sequences over the next seconds, for the state machine
+  LaneSequencePlanner lane_sequence;
+  // Scratch for the oriented box checks of lane changes
+  BoxPath ego_boxes;
+  BoxPath car_boxes;
+  vector<double> separation;
+  // Scratch for the sensor fusion data, kept to avoid reallocating per tick
+  SensorFusionBatch fusion;
+  // The path the new points are sampled from
+  FittedPath path;
+  // How much of the previous path is kept, and the lane and speed last
+  // decided on, to measure how long decisions take to reach the road
+  PathReuse path_reuse;
+  int decided_lane;
+  double decided_speed;
+  double time;
+  // Number of path points in our last answer
+  int sent_size;
+};
+
+// Waypoints of the highway map
+struct MapWaypoints {
+  explicit MapWaypoints(double max_s) : lanes(max_s) {}
+
+  vector<double> x;
+  vector<double> y;
+  vector<double> s;
+  vector<double> dx;
+  vector<double> dy;
+  // Splits velocities along and across the road, built from the normals
+  FrenetProjector frenet;
+  // Number and width of the lanes along the road
+  LaneGeometry lanes;
+  // Path shapes in the ego frame, per speed band
+  MotionPrimitiveLibrary primitives;
+  // Lane centres with their length, heading and curvature
+  LaneCenterlines centerlines;
+};
+
+// Lane change check of the state machine. The lane change is swept with
+// oriented boxes: we move to the centre of target_lane in kLaneChangeTime
+// at constant speed, every car the lane index has near that lane keeps its
+// predicted speed, and each box reaches ahead by the distance its vehicle
+// covers in kReactionTime. The lane is clear if the boxes stay
+// kMinClearance apart for the whole sweep.
+const double kLaneChangeTime = 2.0;  // s
+const double kSweepTime = 3.0;       // s
+const double kSweepStep = 0.1;       // s
+const double kReactionTime = 0.8;    // s
+const double kMinClearance = 1.0;    // m
+const double kCarLength = 5.0;       // m
+const double kCarWidth = 2.5;        // m
+
+bool LaneChangeClear(PlannerState &state, int target_lane, double car_s,
+                     double car_d, double speed) {
+  const int n = static_cast<int>(kSweepTime / kSweepStep) + 1;
+  const double target_d = state.lanes->Center(target_lane, car_s);
+
+  // Our path, relative to car_s; x runs along the road, y across it
+  BoxPath &ego = state.ego_boxes;
+  ego.Resize(n);
+  double reach = speed * kReactionTime / 2;
+  ego.half_length = kCarLength / 2 + reach;
+  ego.half_width = kCarWidth / 2;
+  for (int k = 0; k < n; k++) {
+    double t = k * kSweepStep;
+    double tau = min(t / kLaneChangeTime, 1.0);
+    double tau2 = tau * tau;
+    double d = car_d + (target_d - car_d) * tau2 * tau * (10 - 15 * tau + 6 * tau2);
+    double d_dot = (target_d - car_d) / kLaneChangeTime * 30 * tau2 * (1 - tau) * (1 - tau);
+    double norm = sqrt(speed * speed + d_dot * d_dot);
+    double c = norm > 0 ? speed / norm : 1;
+    double si = norm > 0 ? d_dot / norm : 0;
+    ego.x[k] = speed * t + reach * c;
+    ego.y[k] = d + reach * si;
+    ego.cos[k] = c;
+    ego.sin[k] = si;
+  }
 
-  ifstream in_map_(map_file_.c_str(), ifstream::in);
+  // Every car that could get near us in the sweep, driving along its lane
+  BoxPath &car = state.car_boxes;
+  car.Resize(n);
+  car.half_width = kCarWidth / 2;
+  double max_closing = 2 * 49.5 / 2.24 * kSweepTime;
+  bool clear = true;
+  state.lane_index.Visit(target_lane, car_s - max_closing, car_s + max_closing,
+      [&](const LaneIndex::Entry &entry, double ds) {
+        if (!clear) {
+          return;
+        }
+        double car_speed = state.check_v[entry.id];
+        double car_reach = car_speed * kReactionTime / 2;
+        car.half_length = kCarLength / 2 + car_reach;
+        double start = ds - max_closing;
+        for (int k = 0; k < n; k++) {
+          car.x[k] = start + car_speed * k * kSweepStep + car_reach;
+          car.y[k] = state.check_d[entry.id];
+          car.cos[k] = 1;
+          car.sin[k] = 0;
+        }
+        if (MinBoxSeparation(n, ego, car, state.separation) < kMinClearance) {
+          clear = false;
+        }
+      });
+  return clear;
+}
 
-  string line;
-  while (getline(in_map_, line)) {
-  	istringstream iss(line);
-  	double x;
-  	double y;
-  	float s;
-  	float d_x;
-  	float d_y;
-  	iss >> x;
-  	iss >> y;
-  	iss >> s;
-  	iss >> d_x;
-  	iss >> d_y;
-  	map_waypoints_x.push_back(x);
-  	map_waypoints_y.push_back(y);
-  	map_waypoints_s.push_back(s);
-  	map_waypoints_dx.push_back(d_x);
-  	map_waypoints_dy.push_back(d_y);
+// Hazard check of the path reuse: a car ahead on our lane, or moving into
+// it, that we would get closer to than kHazardGap plus what we close in
+// kReactionTime by the end of the committed path, if it keeps its
+// estimated acceleration. The committed path is then cut so the speed
+// profile can react right away instead of after it.
+const double kHazardGap = 2.0;  // m, bumper to bumper
+
+// Curve speed limit: the largest curvature of our lane this far ahead of the
+// path end sets the speed, so the car is slow enough when it gets there.
+const double kCurveLookahead = 60.0;   // m
+const double kMaxLateralAccel = 5.0;   // m/s^2
+
+bool PathHazard(PlannerState &state, const LaneGeometry &lanes, double car_s,
+                double end_s, double end_d, double end_speed,
+                double committed_time) {
+  int ego_lane = lanes.LaneAt(end_s, end_d);
+  const Tracker &tracker = state.tracker;
+  const KalmanFilterBank &kalman = state.kalman;
+  for (int track_index : tracker.live()) {
+    if (tracker.track(track_index).last_tick != tracker.tick()) {
+      continue;
+    }
+    double d = kalman.d(track_index);
+    double end_car_d = d + kalman.speed_d(track_index) * committed_time;
+    if (lanes.LaneAt(kalman.s(track_index), d) != ego_lane &&
+        lanes.LaneAt(kalman.s(track_index), end_car_d) != ego_lane) {
+      continue;
+    }
+    // Only cars in front of us now
+    double gap_now = lanes.WrapDelta(kalman.s(track_index), car_s);
+    if (gap_now <= 0) {
+      continue;
+    }
+    double end_car_s = kalman.PredictS(track_index, committed_time);
+    double end_car_speed = kalman.PredictSpeedS(track_index, committed_time);
+    double gap_end = lanes.WrapDelta(end_car_s, end_s);
+    double needed = kCarLength + kHazardGap +
+                    max(0.0, end_speed - end_car_speed) * kReactionTime;
+    if (gap_end < needed) {
+      return true;
+    }
   }
-  
-    // Set staring velocity, starting lane and starting state
-	double  ref_vel=1;
-    int lane=1;
-	int current_state=0;
-  h.onMessage([&lane,&ref_vel,&current_state,&map_waypoints_x,&map_waypoints_y,&map_waypoints_s,&map_waypoints_dx,&map_waypoints_dy](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
-                     uWS::OpCode opCode) {
-    // "42" at the start of the message means there's a websocket message event.
-    // The 4 signifies a websocket message
-    // The 2 signifies a websocket event
-    //auto sdata = string(data).substr(0, length);
-    //cout << sdata << endl;
-    if (length && length > 2 && data[0] == '4' && data[1] == '2') {
-
-      auto s = hasData(data);
+  return false;
+}
 
-      if (s != "") {
-        auto j = json::parse(s);
-        
-        string event = j[0].get<string>();
-        
-        if (event == "telemetry") {
-          // j[1] is the data JSON object
-          
-        	// Main car's localization Data
-          	double car_x = j[1]["x"];
-          	double car_y = j[1]["y"];
-          	double car_s = j[1]["s"];
-          	double car_d = j[1]["d"];
-          	double car_yaw = j[1]["yaw"];
-          	double car_speed = j[1]["speed"];
-
-          	// Previous path data given to the Planner
-          	auto previous_path_x = j[1]["previous_path_x"];
-          	auto previous_path_y = j[1]["previous_path_y"];
-          	// Previous path's end s and d values 
-          	double end_path_s = j[1]["end_path_s"];
-          	double end_path_d = j[1]["end_path_d"];
-
-          	// Sensor Fusion Data, a list of all other cars on the same side of the road.
-          	auto sensor_fusion = j[1]["sensor_fusion"];
-
-          	json msgJson;
+// Plans one telemetry event and returns the control message for the
+// simulator, or "" if the event needs no answer.
+string ProcessTelemetry(const string &s, chrono::steady_clock::time_point received,
+                        PlannerState &state, PlannerMode planner_mode,
+                        const MapWaypoints &map) {
+  int &lane = state.lane;
+  double &ref_vel = state.ref_vel;
+  SpeedProfile &speed_profile = state.speed_profile;
+  int &current_state = state.current_state;
+  LatticePlanner &lattice_planner = state.lattice_planner;
+
+  auto j = json::parse(s);
+  
+  string event = j[0].get<string>();
+  
+  if (event == "telemetry") {
+    // j[1] is the data JSON object
+    
+  	// Main car's localization Data
+    	double car_x = j[1]["x"];
+    	double car_y = j[1]["y"];
+    	double car_s = j[1]["s"];
+    	double car_d = j[1]["d"];
+    	double car_yaw = j[1]["yaw"];
+
+    	// Previous path data given to the Planner
+    	auto previous_path_x = j[1]["previous_path_x"];
+    	auto previous_path_y = j[1]["previous_path_y"];
+    	// Previous path's end s and d values 
+    	double end_path_s = j[1]["end_path_s"];
+    	double end_path_d = j[1]["end_path_d"];
+
+    	// Sensor Fusion Data, a list of all other cars on the same side of the road.
+    	auto sensor_fusion = j[1]["sensor_fusion"];
+
+    	json msgJson;
 
 			int prev_size=previous_path_x.size();
 
@@ -269,6 +490,74 @@ int main() {
 				car_s=end_path_s;
 				
 			}
+			
+			// The simulator consumed the points we sent that are no longer in the
+			// previous path, so the session clock advances by that many steps
+			double tick_dt=0;
+			if(state.sent_size>prev_size){
+				tick_dt=(state.sent_size-prev_size)*.02;
+				state.time+=tick_dt;
+			}
+			PathReuse &path_reuse=state.path_reuse;
+			path_reuse.Consume(state.sent_size-prev_size);
+			
+			// Split every car's velocity into speeds along and across the road in
+			// one batch
+			SensorFusionBatch &fusion = state.fusion;
+			int num_fusion=sensor_fusion.size();
+			fusion.Resize(num_fusion);
+			for(int i=0; i<num_fusion; i++){
+				fusion.vx[i] = sensor_fusion[i][3];
+				fusion.vy[i] = sensor_fusion[i][4];
+				fusion.s[i] = sensor_fusion[i][5];
+				fusion.d[i] = sensor_fusion[i][6];
+			}
+			map.frenet.Project(num_fusion,fusion.s.data(),fusion.vx.data(),fusion.vy.data(),
+			                   fusion.speed_s.data(),fusion.speed_d.data());
+			map.lanes.AssignLanes(num_fusion,fusion.s.data(),fusion.d.data(),fusion.lane.data());
+			const int num_lanes=map.lanes.num_lanes();
+			
+			// Update the per-vehicle tracks and their Frenet Kalman filters
+			Tracker &tracker = state.tracker;
+			KalmanFilterBank &kalman = state.kalman;
+			tracker.BeginTick(state.time);
+			kalman.Predict(tick_dt);
+			for(int i=0; i<num_fusion; i++){
+				int track_index=tracker.Observe(sensor_fusion[i][0]);
+				if(track_index<0){
+					continue;
+				}
+				if(tracker.track(track_index).num_samples==1){
+					kalman.Init(track_index,fusion.s[i],fusion.speed_s[i],fusion.d[i],fusion.speed_d[i]);
+				}else{
+					kalman.SetMeasurement(track_index,fusion.s[i],fusion.speed_s[i],fusion.d[i],fusion.speed_d[i]);
+				}
+			}
+			tracker.EndTick();
+			kalman.Update();
+			
+			// Score every track's lane-change intent from its filtered d and d_dot
+			state.intent_classifier->Classify(map.lanes,kalman.capacity(),kalman.s_data(),kalman.d_data(),kalman.speed_d_data(),
+			                                  state.p_keep.data(),state.p_left.data(),state.p_right.data());
+			
+			// On a hazard, keep only the start of the previous path and plan on from
+			// there, restarting the speed profile at the last kept point
+			bool hazard=prev_size>0 &&
+			    PathHazard(state,map.lanes,j[1]["s"].get<double>(),end_path_s,end_path_d,ref_vel/2.24,prev_size*.02);
+			int keep=path_reuse.Keep(prev_size,hazard);
+			path_reuse.Truncate(prev_size,keep);
+			if(keep<prev_size){
+				// Frenet position of the last kept point, from the centre line of
+				// the lane the path ends on
+				int end_lane=max(0,map.lanes.LaneAt(end_path_s,end_path_d));
+				map.centerlines.ToFrenet(end_lane,previous_path_x[keep-1],previous_path_y[keep-1],
+				                         end_path_s,50,&car_s,&end_path_d);
+				const PathReuse::Point &point=path_reuse.point(keep-1);
+				speed_profile.Reset(point.speed,point.accel);
+				ref_vel=point.speed*2.24;
+				cout << "hazard ahead, keeping " << keep << " of " << prev_size << " points\n";
+				prev_size=keep;
+			}
 
 			
 
@@ -277,334 +566,326 @@ int main() {
 // Process sensor fusion data for all lanes for state machine
 
   			
- 			bool too_close_lane0 = false;
-			bool too_close_lane1 = false;
-			bool too_close_lane2 = false;
 		
 		
 			
-			vector<bool> too_close_all_lanes(3);
-			vector<bool> too_close_all_lanes_back(3);
-			vector<bool> too_close_all_lanes_front(3);
+			vector<bool> too_close_all_lanes(num_lanes);
+			vector<bool> too_close_all_lanes_front(num_lanes);
 			// Position and velocity of the closest car in front of us on all lanes
-			vector<double> closest_car_s(3);
-			vector<double> closest_car_v(3);
-			// Position and velocity of the closest car on our back for all lanes
-			vector<double> closest_car_back_s(3);
-			vector<double> closest_car_back_v(3);
+			vector<double> closest_car_s(num_lanes);
+			vector<double> closest_car_v(num_lanes);
 			
 			// initialize vectors
-			for(int lanes=0;lanes<3;lanes++){
+			for(int lanes=0;lanes<num_lanes;lanes++){
 			too_close_all_lanes[lanes]=false;
 			too_close_all_lanes_front[lanes]=false;
-			too_close_all_lanes_back[lanes]=false;
 			closest_car_v[lanes]=-1;
 		
 			}
 		
  			
-			// Loop through all vehicles detected by sensor fusion and process their posion and velocity data
-			for(int i=0; i<sensor_fusion.size(); i++){
+			// Predict every car to the end of the previous path and sort them by s
+			// on each lane, so the gap checks below only look at the cars in range
+			vector<double> &check_s=state.check_s;
+			vector<double> &check_v=state.check_v;
+			vector<double> &check_d=state.check_d;
+			check_s.resize(sensor_fusion.size());
+			check_d.resize(sensor_fusion.size());
+			check_v.resize(sensor_fusion.size());
+			LaneIndex &lane_index=state.lane_index;
+			lane_index.Clear();
+			for(int i=0; i<num_fusion; i++){
 				// Get Frenet d coordinate, 
 				float d=sensor_fusion[i][6];
+				int track_index=tracker.Find(sensor_fusion[i][0]);
 				
-				// Check through all 3 lanes
-				for(int lanes=0;lanes<3;lanes++){
-				// Assign car to a lane according to its position
-				if(d<(2+4*lanes+2) && d>(2+4*lanes-2)) 
-				{
-					double vx = sensor_fusion[i][3];
-					double vy = sensor_fusion[i][4];
-					// Car speed
-					double check_speed=sqrt(vx*vx+vy*vy);
-					// Position s  in Frenet
-					double check_car_s =sensor_fusion[i][5];
+				double vx = sensor_fusion[i][3];
+				double vy = sensor_fusion[i][4];
+				// Car speed
+				double check_speed=sqrt(vx*vx+vy*vy);
+				// Position s  in Frenet
+				double check_car_s =sensor_fusion[i][5];
+				if(track_index>=0){
+					// Predict future position from the filtered speed and acceleration
+					check_speed=kalman.PredictSpeedS(track_index,prev_size*.02);
+					check_car_s=kalman.PredictS(track_index,prev_size*.02);
+				}else{
 					// Predict future position
 					check_car_s+=((double)prev_size*.02*check_speed);
-					
-					// Check cars in front of us on this lane
-					if( (check_car_s-car_s)<30 && (check_car_s-car_s)>0 ) 
-					{
-					if(too_close_all_lanes_front[lanes]==false){
-					// If this is the first car on same lane, set it as the closest car and assign its speed
-					too_close_all_lanes_front[lanes]=true;
-					// Calculate distance to the car
-					closest_car_s[lanes]=(check_car_s-car_s);
-					closest_car_v[lanes]=check_speed*2.23; // Transform to miles per hour
-					} else{
-					too_close_all_lanes_front[lanes]=true;
-					// If there's another car closer on the same lane, update it as the closest car and set its speed
-					if((check_car_s-car_s)<closest_car_s[lanes]){
-					closest_car_s[lanes]=(check_car_s-car_s);
-					closest_car_v[lanes]=check_speed*2.23; // Transform to miles per hour
-					}
-					
+				}
+				check_s[i]=check_car_s;
+				check_d[i]=d;
+				check_v[i]=check_speed;
+				
+				// Assign car to a lane according to its position
+				int car_lane=fusion.lane[i];
+				lane_index.Insert(car_lane,i,check_car_s);
+				// A car that is likely changing lanes also counts on the lane it is
+				// moving into
+				if(track_index>=0 && car_lane>=0){
+					if(state.p_left[track_index]>.5){
+						lane_index.Insert(car_lane-1,i,check_car_s);
+					}else if(state.p_right[track_index]>.5){
+						lane_index.Insert(car_lane+1,i,check_car_s);
 					}
-					// Mark that there is a car too close on this lane
+				}
+			}
+			lane_index.Sort();
+			
+			// Check through all lanes
+			for(int lanes=0;lanes<num_lanes;lanes++){
+				// Closest car in front of us on this lane, within 40 m: about where the
+				// car-following model starts to hold us back, so we look for a pass
+				lane_index.Visit(lanes,car_s,car_s+40,[&](const LaneIndex::Entry &car, double ds){
+					if(ds>0 && too_close_all_lanes_front[lanes]==false){
+					// Mark that there is a car too close on this lane, calculate distance to the car and assign its speed
+					too_close_all_lanes_front[lanes]=true;
 					too_close_all_lanes[lanes]=true;
-											
+					closest_car_s[lanes]=ds;
+					closest_car_v[lanes]=check_v[car.id]*2.23; // Transform to miles per hour
 					}
-					
-					// Check if the car is behind us
-					if((check_car_s-car_s)>(-20) && (check_car_s-car_s)<0)
-					{
-					if(too_close_all_lanes_back[lanes]==false){
-					// If this is the first car on same lane, set it as the closest car behind us and give its speed
-					too_close_all_lanes_back[lanes]=true;
-					// Calculate distance to the car
-					closest_car_back_s[lanes]=(check_car_s-car_s);
-					closest_car_back_v[lanes]=check_speed*2.23;
-					} else{
-					// If there's another car closer behind us on the same lane, update it as the closest car behind us and set its speed
-					too_close_all_lanes_back[lanes]=true;
-					if((check_car_s-car_s)>closest_car_s[lanes]){
-					closest_car_back_s[lanes]=(check_car_s-car_s);
-					closest_car_back_v[lanes]=check_speed*2.23;// Transform to miles per hour
-					}
-					
+				});
+				// Closest cars within 100 m in front and 30 m behind, for the
+				// behavior costs; lanes without one look empty
+				LaneTraffic &traffic=state.lane_traffic;
+				traffic.Resize(num_lanes);
+				traffic.gap_ahead[lanes]=1000;
+				traffic.gap_behind[lanes]=1000;
+				traffic.speed_ahead[lanes]=49.5/2.24;
+				lane_index.Visit(lanes,car_s,car_s+100,[&](const LaneIndex::Entry &car, double ds){
+					if(ds>0 && ds<traffic.gap_ahead[lanes]){
+						traffic.gap_ahead[lanes]=ds;
+						traffic.speed_ahead[lanes]=check_v[car.id];
 					}
-					// Set that there is a car too close on this lane
-					too_close_all_lanes_back[lanes]=true;
-					}										
-				}
+				});
+				lane_index.Visit(lanes,car_s-30,car_s,[&](const LaneIndex::Entry &car, double ds){
+					traffic.gap_behind[lanes]=30-ds;
+				});
 			}
-}
+			
 		
 		
 			
-			// ###############################################################
-			// Finite state machine
-			
-			// We use a finite state machine with 5 states for behavior planning, each having a cost function to decide possible transions to other states
-			// Some states allow a self-transition, staying in the same state
-			// At each time step we choose the transition that has the lowest cost (can be a self-transition)			
-			
-			// The following 5 states are considered
-			// 0 keep current lane // 1 prepare to change left // 2 prepare to change right // 3 change to left // 4 change to right
+			// Keep, lane change and braking futures of every vehicle, from now on
+			vector<VehicleEstimate> &vehicle_estimates=state.vehicle_estimates;
+			vehicle_estimates.clear();
+			for(int track_index : tracker.live()){
+				const Track &track=tracker.track(track_index);
+				if(track.last_tick!=tracker.tick()){
+					continue;
+				}
+				VehicleEstimate estimate;
+				estimate.s=kalman.s(track_index);
+				estimate.d=kalman.d(track_index);
+				estimate.speed_s=kalman.speed_s(track_index);
+				estimate.accel_s=kalman.accel_s(track_index);
+				estimate.p_keep=state.p_keep[track_index];
+				estimate.p_left=state.p_left[track_index];
+				estimate.p_right=state.p_right[track_index];
+				vehicle_estimates.push_back(estimate);
+			}
+			state.prediction.Predict(vehicle_estimates);
 			
-			// Allowed transitions are
-			// 0 - 0,1,2  
-			// 1 - 0,1,2,3
-			// 2 - 0,1,2,4
-			// 3 - 0
-			// 4 - 0
+			if(planner_mode==kLatticePlanner){
+			// ###############################################################
+			// Sampling-based planner
 			
-			// Initialize costs vector. Unaccepted transitions are give weight 10 and not touched later.
-			// Allowed transitions will be later given a weight between 0 and 1
-			vector<double> costs(5);
-			for(int costs_i =0;costs_i<5;costs_i++){
-				costs[costs_i]=10;
+			// Score a lattice of lane / target speed / horizon candidates against the
+			// predicted traffic and follow the cheapest one
+			vector<Obstacle> obstacles;
+			for(int track_index : tracker.live()){
+				const Track &track=tracker.track(track_index);
+				if(track.last_tick!=tracker.tick()){
+					continue;
+				}
+				Obstacle obstacle;
+				// Predict to the end of the previous path, like the gap checks above
+				obstacle.s=kalman.PredictS(track_index,prev_size*.02);
+				obstacle.d=kalman.d(track_index)+kalman.speed_d(track_index)*prev_size*.02;
+				obstacle.speed_s=kalman.PredictSpeedS(track_index,prev_size*.02);
+				obstacle.speed_d=kalman.speed_d(track_index);
+				obstacle.accel_s=kalman.accel_s(track_index);
+				obstacles.push_back(obstacle);
 			}
 			
-			// Check current state
-			switch(current_state)	{
+			EgoState ego;
+			ego.s=car_s;
+			ego.d=(prev_size>0) ? end_path_d : car_d;
+			ego.speed=ref_vel/2.24;
+			ego.time=prev_size*.02;
+			Candidate best=lattice_planner.Plan(ego,obstacles,state.prediction,received);
 			
-			case 0: // State 0: keep current lane
-			  
-			  if(too_close_all_lanes_front[lane]){
-			  // If there is a car in front of us too close, increase the cost of staying on the lane higher than preparing to change lanes
-			    costs[0]=0.5; 
-			  }
-			  else{
-			  // If there is no car too close in the front, keep on the lane
-			    costs[0]=0;
-			  }
-			 
-			 // If our car is already on the right, we cannot change right. Otherwise, we can start preparing to change lanes
-			  if(lane==2){
-			    costs[2]=1;
-			  }else{
-			    costs[2]=0.4;
-			  }
-			  // If our car is already on the left, we cannot change left. Otherwise, we can start preparing to change lanes. 
-			  // Chancing to the left is more preferable than changing to the right if both are possible
-			  if(lane==0){
-			    costs[1]=1;
-			  }else{
-			    costs[1]=0.3;
-			  }
-			  
-			  // In state 0, effectively the cost of maintaining a speed lower than allowed has a higher cost than increasing the speed towards the limit
-			  // We increase speed if it is lower than allowed
-			  // Effectively, a speed higher than the limit 49.5mph has an infinite cost and is not possible  
-			  if(ref_vel<49.5){
-			    ref_vel+=.424;}
- 			  
-			  // Choose state transion that has the lowest cost
-			  current_state=indexofSmallestElement(costs,5);			    			  
-			  break;
-			  
-			case 1: // State 1: prepare to change left
-			  // If there isn't a car too close in the front or behind on the left lane, transition to state 3 is preferred
-			  // If too close, transition is denied
-			  if(too_close_all_lanes_front[lane-1]==false && too_close_all_lanes_back[lane-1]==false){
-			    costs[3]=0;
-			  }else{
-			    costs[3]=1;
-			  }
-			  
-			  // If already on the right, cannot transition to state 2
-			  if(lane==2){
-			    costs[2]=1;
-			  }else{ // Otherwise, we can consider preparing to change right, if it doesnt have another car too close
-			    if(too_close_all_lanes_front[lane+1]==false && too_close_all_lanes_back[lane+1]==false){
-			      costs[2]=0.5;
-			    }else{
-			      costs[2]=1;
-			    }
+			lane=best.lane;
+			// The speed profile moves towards the chosen speed point by point
+			double target_vel=best.target_speed*2.24;
+			speed_profile.set_target(best.target_speed);
 			
-			  }
-			  // If the car in front of gets further away fron us, we can consider transition back to state 0
-			  if(too_close_all_lanes_front[lane]==false ){
-			  	costs[0]=0.8;
-				
-			  }
-			  // If all cars in front of us on our lane disappear, transition to state 0
-			   if(closest_car_v[lane]==-1){
-			  	costs[0]=0;
-				
-			  }
-			  // If we are approaching the car, reduce speed until matching velocity
-  			  if(ref_vel>closest_car_v[lane]){
-			    ref_vel-=.324;
- 			 cout << "car too close, breaking. Closest car vel is " << closest_car_v[lane] << "\n" ;
-				}
-				// Accelerate, if needed, to match speed
-			  else{ref_vel+=.424;
-			  cout << "accelerating again \n";
-			  }
-			  // Stay on this state if other transitions are not preferable
-			  costs[1]=0.7;
+			cout << "lattice lane " << best.lane << " speed " << target_vel << " cost " << best.cost << " (" << lattice_planner.num_evaluated() << "/" << lattice_planner.num_candidates() << " in " << lattice_planner.elapsed_ms() << " ms, " << lattice_planner.num_refine_rounds() << " refinements, deadline hit " << lattice_planner.num_deadline_hits() << "/" << lattice_planner.num_plans() << ")\n";
 			
-			  // Choose the state transition that has the lowest cost
-			  current_state=indexofSmallestElement(costs,5);
-			  break;
-			  
-			case 2: // State 2: Preparing to change right
-			  // See comments of state 1 (prepare to change left). This is just its mirror image. 
-			  if(too_close_all_lanes_front[lane+1]==false && too_close_all_lanes_back[lane+1]==false){
-			    costs[4]=0;
-			  }else{
-			    costs[4]=1;
-			  }
-			  
-			  if(lane==0){
-			    costs[1]=1;
-			  }else{
-			    if(too_close_all_lanes_front[lane-1]==false && too_close_all_lanes_back[lane-1]==false){
-			      costs[1]=0.5;
-			    }else{
-			      costs[1]=1;
-			    }
-
-			  }
-  			  if(ref_vel>closest_car_v[lane]){
-			    cout << "car too close, breaking. Closest car vel is " << closest_car_v[lane] << "\n" ;
-				ref_vel-=.324;}
-			  else{
-			    cout << "accelerating again \n";
-			    ref_vel+=.424;}
-			  costs[2]=0.7;
+			}else{
 			
-			  if(too_close_all_lanes_front[lane]==false ){
-			  	costs[0]=0.8;
-				
-			  }
-  			
-			  if(closest_car_v[lane]==-1){
-			  	costs[0]=0;
-				
-			  } 
-			
-			  current_state=indexofSmallestElement(costs,5);
-			  break;
+				// ###############################################################
+				// Finite state machine
 			
-			case 3: // State 3: change to left
-			lane=lane-1;
-			// The only possible action is to change to left and transition back to state 0 
-			current_state=0;
-			break;
+				// We use a finite state machine with 5 states for behavior planning, each having a cost function to decide possible transions to other states
+				// Some states allow a self-transition, staying in the same state
+				// At each time step we choose the transition that has the lowest cost (can be a self-transition)			
 			
-			case 4: //State 4: change to right
-			lane=lane+1;
-			// The only possible action is to change to right and transition back to state 0 
-			current_state=0;
-			break;
-			}
+				// The following 5 states are considered
+				// 0 keep current lane // 1 prepare to change left // 2 prepare to change right // 3 change to left // 4 change to right
 			
-			cout << "current_state " << current_state << "\n";
- 			
-
-
-		   // As trajectory generation I just use the method presented in the project walkthrough
-		   // It needs as inputs the chosen reference speed and lane to follow (or change to) 
-			vector<double> ptsx;
-			vector<double> ptsy;
-					  			
-			double ref_x = car_x;
-			double ref_y = car_y;
-			double ref_yaw =deg2rad(car_yaw);
+				// Allowed transitions are
+				// 0 - 0,1,2  
+				// 1 - 0,1,2,3
+				// 2 - 0,1,2,4
+				// 3 - 0
+				// 4 - 0
 			
-			if(prev_size<2)
-			{
-				double prev_car_x = car_x -cos(car_yaw);
-				double prev_car_y = car_y -sin(car_yaw);
-				
-				ptsx.push_back(prev_car_x);
-				ptsx.push_back(car_x);
-				
-				ptsy.push_back(prev_car_y);
-				ptsy.push_back(car_y);
+				// The transitions and their costs are declared as a table in
+				// behavior_fsm.cpp; here we only describe what we see and carry out the
+				// action of the current state
+				BehaviorFsm &fsm=state.fsm;
+				unsigned flags=0;
+				if(too_close_all_lanes_front[lane]) flags|=kCarAhead;
+				// The road may have fewer lanes here than elsewhere on the map
+				int last_lane=map.lanes.num_lanes_at(car_s)-1;
+				if(lane>0) flags|=kLeftLane;
+				if(lane<last_lane) flags|=kRightLane;
+				// Lane changes are checked by sweeping our and the other cars' boxes
+				// over the maneuver, instead of with fixed windows in front and
+				// behind; only the lanes next to ours are swept
+				double change_d=(prev_size>0) ? end_path_d : car_d;
+				if(lane>0 && LaneChangeClear(state,lane-1,car_s,change_d,ref_vel/2.24)) flags|=kLeftClear;
+				if(lane<last_lane && LaneChangeClear(state,lane+1,car_s,change_d,ref_vel/2.24)) flags|=kRightClear;
 				
+				// Lane sequences over the next 10 s; the cost of starting towards
+				// each lane feeds the route term, so a slow lane next to us does
+				// not hide a free one beyond it
+				LaneSequencePlanner &lane_sequence=state.lane_sequence;
+				lane_sequence.Plan(lane,car_s,ref_vel/2.24,prev_size*.02,state.prediction);
+				double best_route=lane_sequence.cost(lane);
+				for(int lanes=0;lanes<num_lanes;lanes++){
+					best_route=min(best_route,lane_sequence.cost(lanes));
 				}
-			else{
-				
-				ref_x=previous_path_x[prev_size-1];
-				ref_y=previous_path_y[prev_size-1];
-				
-				double ref_x_prev = previous_path_x[prev_size-2];
-				double ref_y_prev = previous_path_y[prev_size-2];
-				ref_yaw = atan2(ref_y-ref_y_prev,ref_x-ref_x_prev);
+				for(int lanes=0;lanes<num_lanes;lanes++){
+					state.lane_traffic.route[lanes]=lane_sequence.cost(lanes)-best_route;
+				}
+				cout << "lane sequence";
+				for(int step : lane_sequence.sequence()){
+					cout << " " << step;
+				}
+				cout << " (" << lane_sequence.elapsed_ms() << " ms)\n";
 				
-				ptsx.push_back(ref_x_prev);
-				ptsx.push_back(ref_x);
+				const BehaviorStateInfo &action=fsm.info();
+				lane+=action.lane_shift;
+				// The speed profile moves towards the target point by point, within
+				// the acceleration and jerk limits. Every state aims for the limit of
+				// 49.5mph; following the car in front is left to the car-following
+				// model, which caps the acceleration by the gap
+				speed_profile.set_target(49.5/2.24);
 				
-				ptsy.push_back(ref_y_prev);
-				ptsy.push_back(ref_y);
+				// Choose the state transition that has the lowest cost
+				BehaviorCandidates &candidates=state.behavior_candidates;
+				BehaviorCostModel &costs=state.behavior_costs;
+				fsm.Candidates(flags,lane,candidates);
+				int best=costs.Evaluate(candidates,state.lane_traffic);
+				current_state=fsm.Transition(candidates.to[best]);
 				
+				cout << "behavior costs";
+				for(int c=0;c<candidates.size();c++){
+					cout << " " << candidates.to[c] << ":" << costs.total(c);
+				}
+				cout << ", chosen";
+				for(int t=0;t<kNumCostTerms;t++){
+					BehaviorCostTerm term=static_cast<BehaviorCostTerm>(t);
+					cout << " " << BehaviorCostModel::TermName(term) << " " << costs.term(term,best) << " (" << costs.term_ms(term)*1000/costs.num_evaluations() << " us)";
+				}
+				cout << "\n";
+			
+				cout << "current_state " << current_state << "\n";
 			}
+ 			
 
-			vector<double> next_wp0=getXY(car_s+30,(2+4*lane),map_waypoints_s,map_waypoints_x,map_waypoints_y);
-			vector<double> next_wp1=getXY(car_s+60,(2+4*lane),map_waypoints_s,map_waypoints_x,map_waypoints_y);
-			vector<double> next_wp2=getXY(car_s+90,(2+4*lane),map_waypoints_s,map_waypoints_x,map_waypoints_y);
 
-			ptsx.push_back(next_wp0[0]);
-			ptsx.push_back(next_wp1[0]);
-			ptsx.push_back(next_wp2[0]);
+			// The closest car in front on our lane, and during a lane change also
+			// on the lane we are leaving, is followed by the speed profile
+			LaneTraffic &traffic=state.lane_traffic;
+			double lead_gap=traffic.gap_ahead[lane];
+			double lead_speed=traffic.speed_ahead[lane];
+			int path_lane=map.lanes.LaneAt(car_s,(prev_size>0) ? end_path_d : car_d);
+			if(path_lane>=0 && traffic.gap_ahead[path_lane]<lead_gap){
+				lead_gap=traffic.gap_ahead[path_lane];
+				lead_speed=traffic.speed_ahead[path_lane];
+			}
+			if(lead_gap<1000){
+				speed_profile.set_lead(lead_gap,lead_speed);
+				cout << "following car at " << lead_gap << " m, " << lead_speed*2.24 << " mph\n";
+			}else{
+				speed_profile.clear_lead();
+			}
 			
-			ptsy.push_back(next_wp0[1]);
-			ptsy.push_back(next_wp1[1]);
-			ptsy.push_back(next_wp2[1]);
+			// Slow down ahead of curves sharp enough to need more than
+			// kMaxLateralAccel at our target speed
+			double curvature=map.centerlines.MaxCurvatureAhead(max(path_lane,0),car_s,kCurveLookahead);
+			speed_profile.set_limit((curvature>0) ? sqrt(kMaxLateralAccel/curvature) : 49.5/2.24);
 
-          	vector<double> next_x_vals;
-          	vector<double> next_y_vals;
+
+		   // As trajectory generation I just use the method presented in the project walkthrough
+		   // It needs as inputs the chosen reference speed and lane to follow (or change to) 
+		   // The spline through the anchors comes precomputed from the motion
+		   // primitive of our speed band; only the anchors' offsets are needed
+    	vector<double> next_x_vals;
+    	vector<double> next_y_vals;
 			
-			for (int i=0;i<ptsx.size();i++){
-				double shift_x=ptsx[i]-ref_x;
-				double shift_y=ptsy[i]-ref_y;
+			// The last path is extended while it keeps the same lane (its first
+			// anchor is less than 1 m to the side, which leaves room for the
+			// road's curve), the simulator still follows it (no hazard cut it
+			// short) and we have not passed its first anchor. Otherwise, e.g.
+			// during lane changes, a new one is fitted at the end of the previous
+			// path
+			FittedPath &path=state.path;
+			bool extend=path.valid && lane==path.lane && prev_size>=2 &&
+			    fabs(previous_path_x[prev_size-1].get<double>()-path.end_x)<1e-6 &&
+			    fabs(previous_path_y[prev_size-1].get<double>()-path.end_y)<1e-6 &&
+			    fabs(path.anchor_y[0])<1 && path.x<path.primitive->spacing();
+			if(extend){
+				path.num_extensions++;
+			}else{
+				double ref_x = car_x;
+				double ref_y = car_y;
+				double ref_yaw =deg2rad(car_yaw);
 				
-				ptsx[i]=(shift_x*cos(0-ref_yaw)-shift_y*sin(0-ref_yaw));
-				ptsy[i]=(shift_x*sin(0-ref_yaw)+shift_y*cos(0-ref_yaw));
-			    
+				if(prev_size>=2)
+				{
+					ref_x=previous_path_x[prev_size-1];
+					ref_y=previous_path_y[prev_size-1];
+					
+					double ref_x_prev = previous_path_x[prev_size-2];
+					double ref_y_prev = previous_path_y[prev_size-2];
+					ref_yaw = atan2(ref_y-ref_y_prev,ref_x-ref_x_prev);
+				}
+				
+				// Lateral offsets of the anchors in our frame
+				path.pose=Pose2D(ref_x,ref_y,ref_yaw);
+				path.primitive=&map.primitives.Lookup(speed_profile.speed());
+				double anchor_wx[MotionPrimitive::kNumAnchors];
+				double anchor_wy[MotionPrimitive::kNumAnchors];
+				for(int k=0;k<MotionPrimitive::kNumAnchors;k++){
+					double anchor_s=car_s+(k+1)*path.primitive->spacing();
+					map.centerlines.Position(lane,anchor_s,&anchor_wx[k],&anchor_wy[k]);
+				}
+				path.pose.ToLocalY(MotionPrimitive::kNumAnchors,anchor_wx,anchor_wy,path.anchor_y);
+				
+				double target_x =30.0;
+				double target_y=path.primitive->Offset(path.anchor_y,target_x);
+				path.target_dist =sqrt((target_x)*(target_x)+(target_y)*(target_y));
+				path.x=0;
+				path.lane=lane;
+				path.valid=true;
+				path.num_fits++;
 			}
 			
-			
-			tk::spline s;
-			s.set_points(ptsx,ptsy);
-			
-			
-			
-			for(int i=0;i<previous_path_x.size();i++){
+			for(int i=0;i<prev_size;i++){
 				
 				next_x_vals.push_back(previous_path_x[i]);
 				next_y_vals.push_back(previous_path_y[i]);
@@ -612,43 +893,200 @@ int main() {
 			}
 			
 			double target_x =30.0;
-			double target_y=s(target_x);
-			double target_dist =sqrt((target_x)*(target_x)+(target_y)*(target_y));
-			double x_add_on =0;
+			double x_add_on =path.x;
 			
-			for(int i=1; i<=50-previous_path_x.size();i++){
+			// Every new point gets its own speed from the profile, so the
+			// acceleration does not depend on how many points are appended.
+			// The points are sampled in our frame and moved to the world at once
+			int num_new=max(50-prev_size,0);
+			vector<double> local_x(num_new);
+			vector<double> local_y(num_new);
+			for(int i=0; i<num_new;i++){
 				
-				double N = (target_dist/(.02*ref_vel/2.24));
-				double x_point=x_add_on+(target_x)/N;
-				double y_point=s(x_point);
+				double point_vel=speed_profile.Step(.02);
+				double x_point=x_add_on+target_x*(.02*point_vel)/path.target_dist;
 				
+				local_x[i]=x_point;
+				local_y[i]=path.primitive->Offset(path.anchor_y,x_point);
 				x_add_on=x_point;
+				path_reuse.Add(point_vel,speed_profile.accel());
+			}
+			next_x_vals.resize(prev_size+num_new);
+			next_y_vals.resize(prev_size+num_new);
+			path.pose.ToWorld(num_new,local_x.data(),local_y.data(),next_x_vals.data()+prev_size,next_y_vals.data()+prev_size);
+			path.x=x_add_on;
+			if(!next_x_vals.empty()){
+				path.end_x=next_x_vals.back();
+				path.end_y=next_y_vals.back();
+			}
+			ref_vel=speed_profile.speed()*2.24;
 			
-				double x_ref=x_point;
-				double y_ref=y_point;
-				
-				x_point =(x_ref*cos(ref_yaw)-y_ref*sin(ref_yaw));
-				y_point =(x_ref*sin(ref_yaw)+y_ref*cos(ref_yaw));
-				
-				x_point+=ref_x;
-				y_point+=ref_y;
-				
-				next_x_vals.push_back(x_point);
-				next_y_vals.push_back(y_point);
+			// A new lane or target speed reaches the road after the kept points
+			if(lane!=state.decided_lane || fabs(speed_profile.target()-state.decided_speed)>1){
+				double planning_ms=chrono::duration<double,milli>(chrono::steady_clock::now()-received).count();
+				path_reuse.AddDecision(planning_ms,prev_size);
+				state.decided_lane=lane;
+				state.decided_speed=speed_profile.target();
+				cout << "decision latency " << path_reuse.last_latency_ms() << " ms (mean " << path_reuse.mean_latency_ms() << ", max " << path_reuse.max_latency_ms() << " over " << path_reuse.num_decisions() << " decisions, " << path_reuse.num_truncations() << " truncations; path fitted " << path.num_fits << " times, extended " << path.num_extensions << " times)\n";
 			}
 
 
 
-          	// TODO: define a path made up of (x,y) points that the car will visit sequentially every .02 seconds
-          	msgJson["next_x"] = next_x_vals;
-          	msgJson["next_y"] = next_y_vals;
+    	// TODO: define a path made up of (x,y) points that the car will visit sequentially every .02 seconds
+    	msgJson["next_x"] = next_x_vals;
+    	msgJson["next_y"] = next_y_vals;
 
 			
-          	auto msg = "42[\"control\","+ msgJson.dump()+"]";
+    	auto msg = "42[\"control\","+ msgJson.dump()+"]";
+
+    	//this_thread::sleep_for(chrono::milliseconds(1000));
+    	state.sent_size=next_x_vals.size();
+    	return msg;
+    
+  }
+  return "";
+}
+
+// A simulator connection as seen from the event loop thread, kept in the
+// WebSocket's user data
+struct SimulatorSession {
+  uWS::WebSocket<uWS::SERVER> ws;
+  shared_ptr<PlanningSession> planning;
+};
+
+int main(int argc, char *argv[]) {
+  uWS::Hub h;
+
+  // The finite state machine is the default; "./path_planning lattice" uses
+  // the sampling-based planner instead, and "./path_planning anytime" the
+  // same planner refining its answer until the deadline
+  PlannerMode planner_mode = kStateMachine;
+  LatticeConfig lattice_config;
+  if (argc > 1 && string(argv[1]) == "lattice") {
+    planner_mode = kLatticePlanner;
+  } else if (argc > 1 && string(argv[1]) == "anytime") {
+    planner_mode = kLatticePlanner;
+    lattice_config.anytime = true;
+  }
+  // Optional deadline in milliseconds after receipt of the telemetry
+  if (argc > 2) {
+    lattice_config.deadline_ms = atof(argv[2]);
+  }
+  // A quarter of the cores run planning threads and the pool workers get the
+  // rest, so together they never outnumber the cores. Every planning thread
+  // joins the pool as a caller with a deque of its own.
+  const unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+  const unsigned num_planners = std::max(1u, num_cpus / 4);
+  ThreadPool pool(num_cpus - num_planners + 1, true, num_planners);
+
+  // Waypoint map to read from
+  string map_file_ = "../data/highway_map.csv";
+  // The max s value before wrapping around the track back to 0
+  double max_s = 6945.554;
+
+  // Load up map values for waypoint's x,y,s and d normalized normal vectors
+  MapWaypoints map_waypoints(max_s);
+
+  ifstream in_map_(map_file_.c_str(), ifstream::in);
+
+  string line;
+  while (getline(in_map_, line)) {
+  	istringstream iss(line);
+  	double x;
+  	double y;
+  	float s;
+  	float d_x;
+  	float d_y;
+  	iss >> x;
+  	iss >> y;
+  	iss >> s;
+  	iss >> d_x;
+  	iss >> d_y;
+  	// Optional lane layout from this waypoint on: number of lanes and width
+  	int num_lanes;
+  	double lane_width;
+  	if (iss >> num_lanes >> lane_width) {
+  	  map_waypoints.lanes.AddSegment(s, num_lanes, lane_width);
+  	}
+  	map_waypoints.x.push_back(x);
+  	map_waypoints.y.push_back(y);
+  	map_waypoints.s.push_back(s);
+  	map_waypoints.dx.push_back(d_x);
+  	map_waypoints.dy.push_back(d_y);
+  }
+  map_waypoints.frenet = FrenetProjector(map_waypoints.s, map_waypoints.dx,
+                                         map_waypoints.dy, max_s);
+  // Lane centres every metre, so lane queries need no waypoint search
+  map_waypoints.centerlines.Build(
+      map_waypoints.lanes, 1.0,
+      [&map_waypoints](double s, double d, double *x, double *y) {
+        vector<double> xy = getXY(s, d, map_waypoints.s, map_waypoints.x,
+                                  map_waypoints.y);
+        *x = xy[0];
+        *y = xy[1];
+      });
+
+  // Lane-change intent model of the other vehicles
+  IntentClassifier intent_classifier;
+  if (!intent_classifier.Load("../data/intent_model.txt")) {
+    cout << "Could not read ../data/intent_model.txt, using the built-in intent model" << endl;
+  }
+  // Weights of the behavior cost terms
+  BehaviorCostModel behavior_costs;
+  if (!behavior_costs.Load("../data/behavior_costs.txt")) {
+    cout << "Could not read ../data/behavior_costs.txt, using the built-in weights" << endl;
+  }
+  
+  // Planning runs on worker threads so a slow planning step does not stall
+  // socket I/O. Every simulator connection gets its own planner state and is
+  // pinned to one worker; answers come back to the event loop through an
+  // async handle.
+  uv_async_t control_async;
+
+  // Open simulator connections, only touched on the event loop thread
+  vector<SimulatorSession *> sessions;
+
+  std::function<void()> send_control = [&sessions]() {
+    for (SimulatorSession *session : sessions) {
+      while (std::unique_ptr<ControlMessage> control = session->planning->outbox.Pop()) {
+        session->ws.send(control->data.data(), control->data.length(),
+                         uWS::OpCode::TEXT);
+      }
+    }
+  };
+  uv_async_init(h.getLoop(), &control_async, [](uv_async_t *async) {
+    (*static_cast<std::function<void()> *>(async->data))();
+  });
+  control_async.data = &send_control;
+
+  // Declared after everything the workers use, so they are joined first
+  vector<unique_ptr<PlanningWorker>> planning_workers;
+  for (unsigned i = 0; i < num_planners; i++) {
+    planning_workers.push_back(unique_ptr<PlanningWorker>(new PlanningWorker(
+        [&control_async]() { uv_async_send(&control_async); })));
+  }
+
+  h.onMessage([](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
+                     uWS::OpCode opCode) {
+    // "42" at the start of the message means there's a websocket message event.
+    // The 4 signifies a websocket message
+    // The 2 signifies a websocket event
+    //auto sdata = string(data).substr(0, length);
+    //cout << sdata << endl;
+    // Planning deadlines are counted from here
+    auto received = chrono::steady_clock::now();
+    if (length && length > 2 && data[0] == '4' && data[1] == '2') {
+
+      auto s = hasData(data);
 
-          	//this_thread::sleep_for(chrono::milliseconds(1000));
-          	ws.send(msg.data(), msg.length(), uWS::OpCode::TEXT);
-          
+      if (s != "") {
+        // Parsing and planning happen on the session's planning thread
+        SimulatorSession *session = static_cast<SimulatorSession *>(ws.getUserData());
+        std::unique_ptr<TelemetryMessage> telemetry(new TelemetryMessage());
+        telemetry->data = s;
+        telemetry->received = received;
+        if (PlanningWorker::Post(*session->planning, std::move(telemetry))) {
+          cout << "planner busy, dropped stale telemetry (" << session->planning->inbox.num_dropped() << " so far)\n";
         }
       } else {
         // Manual driving
@@ -672,12 +1110,40 @@ int main() {
     }
   });
 
-  h.onConnection([&h](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
-    std::cout << "Connected!!!" << std::endl;
+  h.onConnection([&](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
+    // Every simulator gets a fresh planner state
+    shared_ptr<PlannerState> state = make_shared<PlannerState>(&pool, lattice_config, &intent_classifier, behavior_costs, &map_waypoints.lanes);
+    shared_ptr<PlanningSession> planning = make_shared<PlanningSession>(
+        [state, planner_mode, &map_waypoints](const TelemetryMessage &telemetry) {
+          return ProcessTelemetry(telemetry.data, telemetry.received, *state,
+                                  planner_mode, map_waypoints);
+        });
+
+    // Pin the session to the worker with the fewest sessions
+    PlanningWorker *worker = planning_workers[0].get();
+    for (auto &candidate : planning_workers) {
+      if (candidate->num_sessions() < worker->num_sessions()) {
+        worker = candidate.get();
+      }
+    }
+    worker->Attach(planning);
+
+    SimulatorSession *session = new SimulatorSession{ws, planning};
+    ws.setUserData(session);
+    sessions.push_back(session);
+    std::cout << "Connected!!! (" << sessions.size() << " sessions)" << std::endl;
   });
 
-  h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
+  h.onDisconnection([&h,&sessions](uWS::WebSocket<uWS::SERVER> ws, int code,
                          char *message, size_t length) {
+    SimulatorSession *session = static_cast<SimulatorSession *>(ws.getUserData());
+    if (session != nullptr) {
+      session->planning->worker->Detach(session->planning);
+      sessions.erase(std::remove(sessions.begin(), sessions.end(), session),
+                     sessions.end());
+      ws.setUserData(nullptr);
+      delete session;
+    }
     ws.close();
     std::cout << "Disconnected" << std::endl;
   });
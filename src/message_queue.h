@@ -0,0 +1,39 @@
+#ifndef MESSAGE_QUEUE_H_
+#define MESSAGE_QUEUE_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+// Unbounded FIFO queue between two threads. Unlike Mailbox nothing is ever
+// dropped: every value pushed is popped, in order.
+template <typename T>
+class MessageQueue {
+ public:
+  MessageQueue() {}
+
+  MessageQueue(const MessageQueue &) = delete;
+  MessageQueue &operator=(const MessageQueue &) = delete;
+
+  void Push(std::unique_ptr<T> value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    values_.push_back(std::move(value));
+  }
+
+  // Returns the oldest value, or nullptr if there is none.
+  std::unique_ptr<T> Pop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (values_.empty()) {
+      return nullptr;
+    }
+    std::unique_ptr<T> value = std::move(values_.front());
+    values_.pop_front();
+    return value;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::unique_ptr<T>> values_;
+};
+
+#endif  // MESSAGE_QUEUE_H_
@@ -0,0 +1,70 @@
+#include "motion_primitives.h"
+
+#include <algorithm>
+
+#include "spline.h"
+
+namespace {
+
+// Time between the points of the simulator's path.
+const double kPathStep = 0.02;
+// Knot behind the path end when standing still; the spline needs distinct
+// knots.
+const double kMinBack = 0.1;  // m
+
+}  // namespace
+
+MotionPrimitiveConfig::MotionPrimitiveConfig()
+    : band_width(2.5),
+      num_bands(10),
+      anchor_time(1.4),
+      min_spacing(20),
+      max_spacing(30),
+      step(0.25) {}
+
+MotionPrimitiveLibrary::MotionPrimitiveLibrary(
+    const MotionPrimitiveConfig &config)
+    : config_(config), primitives_(std::max(config.num_bands, 1)) {
+  for (int band = 0; band < num_bands(); band++) {
+    MotionPrimitive &primitive = primitives_[band];
+    // The point behind is one path step back at the middle of the band; the
+    // anchors are spaced for its top, so lane changes take about the same
+    // lateral acceleration at every speed.
+    const double back =
+        std::max((band + 0.5) * config.band_width * kPathStep, kMinBack);
+    primitive.spacing_ =
+        std::min(std::max((band + 1) * config.band_width * config.anchor_time,
+                          config.min_spacing),
+                 config.max_spacing);
+    primitive.inv_step_ = 1 / config.step;
+    const int num_samples =
+        static_cast<int>(primitive.length() / config.step) + 2;
+    primitive.last_ = num_samples - 2;
+    primitive.table_.assign(num_samples * MotionPrimitive::kNumAnchors, 0.0);
+
+    // Knots in order of x: the point behind and the path end, both on the
+    // x axis, then the anchors.
+    std::vector<double> x(MotionPrimitive::kNumAnchors + 2);
+    x[0] = -back;
+    x[1] = 0;
+    for (int k = 0; k < MotionPrimitive::kNumAnchors; k++) {
+      x[k + 2] = (k + 1) * primitive.spacing_;
+    }
+    for (int k = 0; k < MotionPrimitive::kNumAnchors; k++) {
+      std::vector<double> y(x.size(), 0.0);
+      y[k + 2] = 1;
+      tk::spline basis;
+      basis.set_points(x, y);
+      for (int i = 0; i < num_samples; i++) {
+        primitive.table_[i * MotionPrimitive::kNumAnchors + k] =
+            basis(i * config.step);
+      }
+    }
+  }
+}
+
+const MotionPrimitive &MotionPrimitiveLibrary::Lookup(double speed) const {
+  int band = static_cast<int>(speed / config_.band_width);
+  band = std::min(std::max(band, 0), num_bands() - 1);
+  return primitives_[band];
+}
@@ -0,0 +1,89 @@
+#ifndef MOTION_PRIMITIVES_H_
+#define MOTION_PRIMITIVES_H_
+
+#include <vector>
+
+struct MotionPrimitiveConfig {
+  MotionPrimitiveConfig();
+
+  double band_width;   // m/s, width of a speed band
+  int num_bands;       // the last band takes every faster speed
+  double anchor_time;  // s, anchor spacing at the top of a band
+  double min_spacing;  // m, bounds on the anchor spacing
+  double max_spacing;  // m
+  double step;         // m, table resolution along the path
+};
+
+// Lateral offset of the path ahead in the ego frame at the end of the
+// previous path: x forward along its heading, y to the left. The path is a
+// spline through a point one path step behind and the path end itself,
+// which fix its heading, and three anchors on the target lane spaced by the
+// band's anchor spacing.
+//
+// The bases assume the anchors sit straight ahead at x = (k + 1) * spacing
+// and only their lateral offsets vary. The caller places them that far
+// along the lane instead, so on a curve their true x falls short of the
+// assumed one by the difference between arc and chord: centimetres at the
+// first anchor, up to about a metre at the last in the highway's sharpest
+// curves. The caller refits the path once the end of the points taken
+// from it passes the first anchor; a fit's first points cover about a
+// second of driving, short of the anchor spacing, and every later tick
+// adds only a few. So points end up at most a tick's worth past the first
+// anchor, and the path is not corrected for it.
+//
+// A spline is linear in its knot values, so the path is the sum of one
+// basis function per anchor times the anchor's lateral offset: a lane
+// change by dy is dy times the sum of the bases, and the road's curvature
+// enters as the anchors' deviation from dy. The bases of each speed band
+// are sampled once at startup and stored anchor-interleaved, so evaluating
+// the path is a table lookup and three multiply-adds per point instead of
+// fitting a spline every tick.
+class MotionPrimitive {
+ public:
+  static const int kNumAnchors = 3;
+
+  // Distance between the anchors, and from the path end to the first.
+  double spacing() const { return spacing_; }
+  // Paths are defined for 0 <= x <= length().
+  double length() const { return kNumAnchors * spacing_; }
+
+  // Lateral offset at x given the anchors' offsets.
+  double Offset(const double *anchor_y, double x) const {
+    double t = x * inv_step_;
+    t = (t < 0) ? 0 : (t > last_) ? last_ : t;
+    const int i = static_cast<int>(t);
+    const double f = t - i;
+    const double *a = &table_[i * kNumAnchors];
+    const double *b = a + kNumAnchors;
+    double y = 0;
+    for (int k = 0; k < kNumAnchors; k++) {
+      y += anchor_y[k] * (a[k] + f * (b[k] - a[k]));
+    }
+    return y;
+  }
+
+ private:
+  friend class MotionPrimitiveLibrary;
+
+  double spacing_;
+  double inv_step_;
+  double last_;  // last sample that has one after it
+  std::vector<double> table_;
+};
+
+// Motion primitives for every speed band, built once.
+class MotionPrimitiveLibrary {
+ public:
+  explicit MotionPrimitiveLibrary(
+      const MotionPrimitiveConfig &config = MotionPrimitiveConfig());
+
+  // Primitive for a path end speed in m/s.
+  const MotionPrimitive &Lookup(double speed) const;
+  int num_bands() const { return static_cast<int>(primitives_.size()); }
+
+ private:
+  MotionPrimitiveConfig config_;
+  std::vector<MotionPrimitive> primitives_;
+};
+
+#endif  // MOTION_PRIMITIVES_H_
@@ -0,0 +1,114 @@
+#include "occupancy_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+OccupancyGrid::OccupancyGrid(const LaneGeometry &lanes, double cell_size,
+                             double behind, double ahead, int steps_per_slice)
+    : lanes_(&lanes),
+      num_lanes_(lanes.num_lanes()),
+      cell_size_(cell_size),
+      behind_(behind),
+      num_cells_(static_cast<int>(std::ceil((behind + ahead) / cell_size))),
+      words_per_row_((num_cells_ + 63) / 64),
+      steps_per_slice_(steps_per_slice),
+      origin_s_(0),
+      half_width_(0),
+      slice_time_(0),
+      num_slices_(0) {}
+
+void OccupancyGrid::SetCells(uint64_t *row, int first, int last) {
+  first = std::max(first, 0);
+  last = std::min(last, num_cells_ - 1);
+  if (first > last) {
+    return;
+  }
+  int first_word = first >> 6;
+  int last_word = last >> 6;
+  uint64_t first_mask = ~uint64_t(0) << (first & 63);
+  uint64_t last_mask = ~uint64_t(0) >> (63 - (last & 63));
+  if (first_word == last_word) {
+    row[first_word] |= first_mask & last_mask;
+    return;
+  }
+  row[first_word] |= first_mask;
+  for (int word = first_word + 1; word < last_word; word++) {
+    row[word] = ~uint64_t(0);
+  }
+  row[last_word] |= last_mask;
+}
+
+void OccupancyGrid::Build(const TrajectoryPredictor &prediction,
+                          double origin_s, double length, double time_gap,
+                          double max_ego_speed, double half_width) {
+  origin_s_ = origin_s;
+  half_width_ = half_width;
+  slice_time_ = steps_per_slice_ * prediction.step();
+  num_slices_ = (prediction.num_steps() - 1) / steps_per_slice_ + 1;
+  bits_.assign(num_slices_ * num_lanes_ * words_per_row_, 0);
+
+  const int num_hypotheses = prediction.num_hypotheses();
+  const double start_s = origin_s_ - behind_;
+  for (int slice = 0; slice < num_slices_; slice++) {
+    // Prediction steps that round to this slice
+    int first_step = std::max(slice * steps_per_slice_ - steps_per_slice_ / 2,
+                              0);
+    int last_step = std::min(slice * steps_per_slice_ + steps_per_slice_ / 2,
+                             prediction.num_steps() - 1);
+    const double *s_first = prediction.s_at(first_step);
+    const double *s_last = prediction.s_at(last_step);
+    const double *d_first = prediction.d_at(first_step);
+    const double *d_last = prediction.d_at(last_step);
+    const double *speed_first = prediction.speed_at(first_step);
+    const double *speed_last = prediction.speed_at(last_step);
+
+    for (int h = 0; h < num_hypotheses; h++) {
+      // s never decreases, and d and the speed move monotonically, so the
+      // ends of the slice bound the motion within it.
+      double speed = std::max(max_ego_speed,
+                              std::max(speed_first[h], speed_last[h]));
+      double s_margin = length + time_gap * speed;
+      double s0 = lanes_->WrapDelta(s_first[h], start_s) - s_margin;
+      double s1 = s0 + (s_last[h] - s_first[h]) + 2 * s_margin;
+      int first_cell = static_cast<int>(std::floor(s0 / cell_size_));
+      int last_cell = static_cast<int>(std::floor(s1 / cell_size_));
+      if (last_cell < 0 || first_cell >= num_cells_) {
+        continue;
+      }
+
+      double lane_width = lanes_->lane_width_at(s_first[h]);
+      double d0 = std::min(d_first[h], d_last[h]) - half_width_;
+      double d1 = std::max(d_first[h], d_last[h]) + half_width_;
+      int first_lane = std::max(static_cast<int>(std::floor(d0 / lane_width)),
+                                0);
+      int last_lane = std::min(static_cast<int>(std::floor(d1 / lane_width)),
+                               num_lanes_ - 1);
+      for (int lane = first_lane; lane <= last_lane; lane++) {
+        SetCells(Row(slice, lane), first_cell, last_cell);
+      }
+    }
+  }
+}
+
+bool OccupancyGrid::Occupied(double t, double s, double d) const {
+  int slice = static_cast<int>(std::floor(t / slice_time_ + 0.5));
+  int cell = static_cast<int>(
+      std::floor(lanes_->WrapDelta(s, origin_s_ - behind_) / cell_size_));
+  if (slice < 0 || slice >= num_slices_ || cell < 0 || cell >= num_cells_) {
+    return true;
+  }
+
+  const double lane_width = lanes_->lane_width_at(s);
+  int first_lane = std::max(
+      static_cast<int>(std::floor((d - half_width_) / lane_width)), 0);
+  int last_lane =
+      std::min(static_cast<int>(std::floor((d + half_width_) / lane_width)),
+               num_lanes_ - 1);
+  const uint64_t bit = uint64_t(1) << (cell & 63);
+  for (int lane = first_lane; lane <= last_lane; lane++) {
+    if (Row(slice, lane)[cell >> 6] & bit) {
+      return true;
+    }
+  }
+  return false;
+}
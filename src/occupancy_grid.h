@@ -0,0 +1,65 @@
+#ifndef OCCUPANCY_GRID_H_
+#define OCCUPANCY_GRID_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "lane_geometry.h"
+#include "prediction.h"
+
+// Per-lane s-t occupancy bitmap of the predicted traffic. Each lane has one
+// row of bits per time slice, one bit per cell of road along s in a window
+// around the ego vehicle. A bit is set when some hypothesis of some vehicle
+// comes close enough to that cell during the slice to matter, so a point of
+// an ego trajectory is checked with a couple of bit tests.
+//
+// Rasterization is conservative: a slice covers every prediction step that
+// rounds to it, and a vehicle marks every lane its footprint touches.
+class OccupancyGrid {
+ public:
+  // The grid covers [origin - behind, origin + ahead) along s in cells of
+  // cell_size metres, and groups steps_per_slice prediction steps into one
+  // time slice. Lanes are those of `lanes`, which must outlive the grid.
+  OccupancyGrid(const LaneGeometry &lanes, double cell_size, double behind,
+                double ahead, int steps_per_slice);
+
+  // Rasterizes all hypotheses of `prediction`. Along the road a vehicle
+  // marks the cells within length + time_gap * max(max_ego_speed, its
+  // speed) of it, across the road every lane within half_width of it.
+  // origin_s anchors the window; the ego vehicle should stay inside it.
+  void Build(const TrajectoryPredictor &prediction, double origin_s,
+             double length, double time_gap, double max_ego_speed,
+             double half_width);
+
+  // True if a vehicle may be close to (s, d) at t seconds after the start of
+  // the prediction, also for points outside the grid. The ego lanes are
+  // those within half_width of d.
+  bool Occupied(double t, double s, double d) const;
+
+ private:
+  // Sets cells [first, last] of a row, clipped to the grid.
+  void SetCells(uint64_t *row, int first, int last);
+  uint64_t *Row(int slice, int lane) {
+    return &bits_[(slice * num_lanes_ + lane) * words_per_row_];
+  }
+  const uint64_t *Row(int slice, int lane) const {
+    return &bits_[(slice * num_lanes_ + lane) * words_per_row_];
+  }
+
+  const LaneGeometry *lanes_;
+  int num_lanes_;
+  double cell_size_;
+  double behind_;
+  int num_cells_;
+  int words_per_row_;
+  int steps_per_slice_;
+
+  // Set by Build().
+  double origin_s_;
+  double half_width_;
+  double slice_time_;
+  int num_slices_;
+  std::vector<uint64_t> bits_;  // num_slices x num_lanes x words_per_row
+};
+
+#endif  // OCCUPANCY_GRID_H_
@@ -0,0 +1,60 @@
+#include "oriented_box.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+inline double Max(double a, double b) { return a > b ? a : b; }
+
+void SeparationKernel(int n, const double *__restrict ax,
+                      const double *__restrict ay,
+                      const double *__restrict ac,
+                      const double *__restrict as, double a_length,
+                      double a_width, const double *__restrict bx,
+                      const double *__restrict by,
+                      const double *__restrict bc,
+                      const double *__restrict bs, double b_length,
+                      double b_width, double *__restrict separation) {
+  for (int k = 0; k < n; k++) {
+    const double tx = bx[k] - ax[k];
+    const double ty = by[k] - ay[k];
+    // Cosines between the axes of a (along, across) and b
+    const double c_aa = std::fabs(ac[k] * bc[k] + as[k] * bs[k]);
+    const double c_ab = std::fabs(ac[k] * bs[k] - as[k] * bc[k]);
+
+    // Along and across a
+    const double gap_a0 = std::fabs(tx * ac[k] + ty * as[k]) -
+                          (a_length + b_length * c_aa + b_width * c_ab);
+    const double gap_a1 = std::fabs(ty * ac[k] - tx * as[k]) -
+                          (a_width + b_length * c_ab + b_width * c_aa);
+    // Along and across b
+    const double gap_b0 = std::fabs(tx * bc[k] + ty * bs[k]) -
+                          (b_length + a_length * c_aa + a_width * c_ab);
+    const double gap_b1 = std::fabs(ty * bc[k] - tx * bs[k]) -
+                          (b_width + a_length * c_ab + a_width * c_aa);
+
+    separation[k] = Max(Max(gap_a0, gap_a1), Max(gap_b0, gap_b1));
+  }
+}
+
+}  // namespace
+
+void BoxSeparation(int n, const BoxPath &a, const BoxPath &b,
+                   double *separation) {
+  SeparationKernel(n, a.x.data(), a.y.data(), a.cos.data(), a.sin.data(),
+                   a.half_length, a.half_width, b.x.data(), b.y.data(),
+                   b.cos.data(), b.sin.data(), b.half_length, b.half_width,
+                   separation);
+}
+
+double MinBoxSeparation(int n, const BoxPath &a, const BoxPath &b,
+                        std::vector<double> &scratch) {
+  if (n <= 0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  scratch.resize(n);
+  BoxSeparation(n, a, b, scratch.data());
+  return *std::min_element(scratch.begin(), scratch.begin() + n);
+}
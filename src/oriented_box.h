@@ -0,0 +1,38 @@
+#ifndef ORIENTED_BOX_H_
+#define ORIENTED_BOX_H_
+
+#include <vector>
+
+// Poses of a rectangular vehicle footprint at a sequence of time steps,
+// structure-of-arrays: centre (x, y) and unit heading (cos, sin). The half
+// extents are the same at every step.
+struct BoxPath {
+  void Resize(int n) {
+    x.resize(n);
+    y.resize(n);
+    cos.resize(n);
+    sin.resize(n);
+  }
+  int size() const { return static_cast<int>(x.size()); }
+
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> cos;
+  std::vector<double> sin;
+  double half_length;
+  double half_width;
+};
+
+// Separating-axis test of two oriented boxes at each of their first n
+// steps. separation[k] is the largest gap between the boxes along any of
+// their four edge normals: positive when they are apart, where it is a lower
+// bound of their distance, and zero or negative when they overlap. The loop
+// runs across steps and vectorizes.
+void BoxSeparation(int n, const BoxPath &a, const BoxPath &b,
+                   double *separation);
+
+// Smallest separation over the first n steps.
+double MinBoxSeparation(int n, const BoxPath &a, const BoxPath &b,
+                        std::vector<double> &scratch);
+
+#endif  // ORIENTED_BOX_H_
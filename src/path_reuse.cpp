@@ -0,0 +1,64 @@
+#include "path_reuse.h"
+
+#include <algorithm>
+
+namespace {
+
+// Time between the points of the simulator's path.
+const double kPathStep = 0.02;
+
+}  // namespace
+
+PathReuseConfig::PathReuseConfig() : normal_keep(-1), hazard_keep(10) {}
+
+PathReuse::PathReuse(const PathReuseConfig &config)
+    : config_(config),
+      num_decisions_(0),
+      num_truncations_(0),
+      last_latency_ms_(0),
+      sum_latency_ms_(0),
+      max_latency_ms_(0) {}
+
+void PathReuse::Consume(int num_points) {
+  num_points = std::min(std::max(num_points, 0), size());
+  points_.erase(points_.begin(), points_.begin() + num_points);
+}
+
+int PathReuse::Keep(int prev_size, bool hazard) const {
+  // Points we have no speed for (e.g. after a reconnect) cannot be cut.
+  if (size() != prev_size) {
+    return prev_size;
+  }
+  int keep = prev_size;
+  if (config_.normal_keep >= 0) {
+    keep = std::min(keep, config_.normal_keep);
+  }
+  if (hazard) {
+    keep = std::min(keep, config_.hazard_keep);
+  }
+  // The spline needs two points to continue from.
+  return (keep < 2) ? std::min(prev_size, 2) : keep;
+}
+
+void PathReuse::Truncate(int prev_size, int keep) {
+  if (keep < prev_size) {
+    num_truncations_++;
+  }
+  if (keep < size()) {
+    points_.resize(keep);
+  }
+}
+
+void PathReuse::Add(double speed, double accel) {
+  Point point;
+  point.speed = speed;
+  point.accel = accel;
+  points_.push_back(point);
+}
+
+void PathReuse::AddDecision(double planning_ms, int committed_points) {
+  last_latency_ms_ = planning_ms + committed_points * kPathStep * 1000;
+  num_decisions_++;
+  sum_latency_ms_ += last_latency_ms_;
+  max_latency_ms_ = std::max(max_latency_ms_, last_latency_ms_);
+}
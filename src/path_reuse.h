@@ -0,0 +1,76 @@
+#ifndef PATH_REUSE_H_
+#define PATH_REUSE_H_
+
+#include <vector>
+
+struct PathReuseConfig {
+  PathReuseConfig();
+
+  // Points of the previous path kept in normal driving, at most; -1 keeps
+  // all of them.
+  int normal_keep;
+  // Points kept when a hazard is detected: enough to hide the planning
+  // time and keep the path continuous, short enough to react quickly.
+  int hazard_keep;
+};
+
+// Decides how much of the path already sent to the simulator is kept each
+// tick, and remembers the speed and acceleration of every point sent so the
+// speed profile can restart from any of them.
+//
+// Keeping the whole previous path is smooth but means a new decision only
+// takes effect once the committed points are driven; on a hazard the
+// committed prefix is cut to hazard_keep points and the new path starts
+// from there, its spline anchored on the last two kept points.
+//
+// Also keeps statistics of the decision-to-actuation latency: the time
+// from the telemetry message a decision was made in to the first point
+// that carries it out, i.e. the planning time plus the committed points
+// ahead of it.
+class PathReuse {
+ public:
+  struct Point {
+    double speed;  // m/s
+    double accel;  // m/s^2
+  };
+
+  explicit PathReuse(const PathReuseConfig &config);
+
+  // Drops the points the simulator has driven since the last tick; the
+  // remaining ones line up with its previous path.
+  void Consume(int num_points);
+  // Number of points of the previous path (prev_size of them) to keep.
+  int Keep(int prev_size, bool hazard) const;
+  // Forgets the points after the first `keep` of the prev_size still ahead
+  // of the car, along with any the simulator no longer has. Only cutting
+  // the simulator's path short (keep < prev_size) counts as a truncation.
+  void Truncate(int prev_size, int keep);
+  // Appends a point sent to the simulator.
+  void Add(double speed, double accel);
+
+  int size() const { return static_cast<int>(points_.size()); }
+  const Point &point(int i) const { return points_[i]; }
+
+  // Records a decision taken `planning_ms` after its telemetry arrived and
+  // carried out after `committed_points` kept points.
+  void AddDecision(double planning_ms, int committed_points);
+  long num_decisions() const { return num_decisions_; }
+  long num_truncations() const { return num_truncations_; }
+  double last_latency_ms() const { return last_latency_ms_; }
+  double mean_latency_ms() const {
+    return num_decisions_ > 0 ? sum_latency_ms_ / num_decisions_ : 0;
+  }
+  double max_latency_ms() const { return max_latency_ms_; }
+
+ private:
+  PathReuseConfig config_;
+  std::vector<Point> points_;
+
+  long num_decisions_;
+  long num_truncations_;
+  double last_latency_ms_;
+  double sum_latency_ms_;
+  double max_latency_ms_;
+};
+
+#endif  // PATH_REUSE_H_
@@ -0,0 +1,95 @@
+#include "planning_worker.h"
+
+#include <algorithm>
+
+PlanningWorker::PlanningWorker(const std::function<void()> &on_control)
+    : on_control_(on_control), stop_(false) {
+  thread_ = std::thread(&PlanningWorker::Run, this);
+}
+
+PlanningWorker::~PlanningWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_cv_.notify_one();
+  thread_.join();
+}
+
+void PlanningWorker::Attach(const std::shared_ptr<PlanningSession> &session) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  session->worker = this;
+  sessions_.push_back(session);
+}
+
+void PlanningWorker::Detach(const std::shared_ptr<PlanningSession> &session) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sessions_.erase(std::remove(sessions_.begin(), sessions_.end(), session),
+                  sessions_.end());
+}
+
+int PlanningWorker::num_sessions() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int>(sessions_.size());
+}
+
+bool PlanningWorker::Post(PlanningSession &session,
+                          std::unique_ptr<TelemetryMessage> telemetry) {
+  bool dropped = session.inbox.Post(std::move(telemetry));
+  session.worker->Wake();
+  return dropped;
+}
+
+void PlanningWorker::Wake() {
+  // Taking the lock orders the post before the worker's emptiness check,
+  // so the wake-up cannot be lost.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  wake_cv_.notify_one();
+}
+
+void PlanningWorker::Run() {
+  // Sessions with telemetry waiting; kept across iterations so the steady
+  // state does not allocate.
+  std::vector<std::shared_ptr<PlanningSession>> ready;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_cv_.wait(lock, [this] {
+        if (stop_) {
+          return true;
+        }
+        for (const auto &session : sessions_) {
+          if (!session->inbox.Empty()) {
+            return true;
+          }
+        }
+        return false;
+      });
+      if (stop_) {
+        return;
+      }
+      for (const auto &session : sessions_) {
+        if (!session->inbox.Empty()) {
+          ready.push_back(session);
+        }
+      }
+    }
+
+    for (const auto &session : ready) {
+      std::unique_ptr<TelemetryMessage> telemetry = session->inbox.Take();
+      if (!telemetry) {
+        continue;
+      }
+      std::unique_ptr<ControlMessage> control(new ControlMessage());
+      control->data = session->handler(*telemetry);
+      if (!control->data.empty()) {
+        session->outbox.Push(std::move(control));
+        on_control_();
+      }
+    }
+    ready.clear();
+  }
+}
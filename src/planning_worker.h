@@ -0,0 +1,88 @@
+#ifndef PLANNING_WORKER_H_
+#define PLANNING_WORKER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mailbox.h"
+#include "message_queue.h"
+
+// Telemetry as received from the simulator, waiting to be planned.
+struct TelemetryMessage {
+  std::string data;
+  std::chrono::steady_clock::time_point received;
+};
+
+// Answer to a telemetry message, waiting to be sent to the simulator.
+struct ControlMessage {
+  std::string data;
+};
+
+class PlanningWorker;
+
+// Planning channel of one simulator connection. Telemetry comes in through
+// a latest-value mailbox: when planning falls behind, stale telemetry is
+// dropped instead of queued. Control messages go out through a queue, since
+// the planner builds each path on the one it planned before and counts the
+// points the simulator consumed from it; every answer has to reach the
+// simulator.
+struct PlanningSession {
+  // Plans one telemetry message and returns the control message, or an
+  // empty string if there is nothing to send. Always called on the same
+  // worker thread, so the planner state it captures needs no locking.
+  typedef std::function<std::string(const TelemetryMessage &)> Handler;
+
+  explicit PlanningSession(const Handler &handler)
+      : handler(handler), worker(nullptr) {}
+
+  Handler handler;
+  Mailbox<TelemetryMessage> inbox;
+  MessageQueue<ControlMessage> outbox;
+  // The worker the session is pinned to, set by PlanningWorker::Attach().
+  PlanningWorker *worker;
+};
+
+// Thread that plans for the sessions pinned to it, so that a slow planning
+// step never stalls the network event loop. Several workers let one process
+// serve many simulators at once.
+class PlanningWorker {
+ public:
+  // `on_control` is called on the worker thread after a control message
+  // has been queued in a session's outbox; it should wake the event loop.
+  explicit PlanningWorker(const std::function<void()> &on_control);
+  ~PlanningWorker();
+
+  void Attach(const std::shared_ptr<PlanningSession> &session);
+  void Detach(const std::shared_ptr<PlanningSession> &session);
+
+  // Hands telemetry to a session and wakes its worker. Called from the
+  // event loop thread; returns true if older telemetry was still waiting
+  // and got dropped.
+  static bool Post(PlanningSession &session,
+                   std::unique_ptr<TelemetryMessage> telemetry);
+
+  int num_sessions();
+
+ private:
+  void Wake();
+  void Run();
+
+  std::function<void()> on_control_;
+
+  // Guards sessions_ and stop_, and is used to sleep while no session has
+  // telemetry waiting.
+  std::mutex mutex_;
+  std::condition_variable wake_cv_;
+  std::vector<std::shared_ptr<PlanningSession>> sessions_;
+  bool stop_;
+
+  std::thread thread_;
+};
+
+#endif  // PLANNING_WORKER_H_
@@ -0,0 +1,29 @@
+#ifndef POSE2D_H_
+#define POSE2D_H_
+
+// Rigid pose in the plane (SE(2)): a position and a heading, with the
+// heading's cos and sin computed once. Moves whole arrays of points
+// between the world frame and the pose's local frame, x forward along the
+// heading and y to the left. The loops run across points and vectorize.
+// Only the directions the path builder needs are provided: lateral offsets
+// of world points, and local points back to the world.
+class Pose2D {
+ public:
+  Pose2D(double x, double y, double heading);
+
+  // Local y (lateral offset) of the world points (x[i], y[i]). local_y must
+  // not overlap the inputs.
+  void ToLocalY(int n, const double *x, const double *y,
+                double *local_y) const;
+  // Local points back to the world frame; the same restriction applies.
+  void ToWorld(int n, const double *local_x, const double *local_y, double *x,
+               double *y) const;
+
+ private:
+  double x_;
+  double y_;
+  double cos_;
+  double sin_;
+};
+
+#endif  // POSE2D_H_
@@ -0,0 +1,156 @@
+#include "prediction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Samples all hypotheses at time t. Every array is a separate restrict
+// pointer so the loop vectorizes across hypotheses.
+void SampleStep(int n, double t, const double *__restrict s0,
+                const double *__restrict v0, const double *__restrict a0,
+                const double *__restrict stop_time,
+                const double *__restrict d0, const double *__restrict d1,
+                const double *__restrict duration,
+                const double *__restrict inv_duration, double *__restrict s,
+                double *__restrict d, double *__restrict speed) {
+  for (int h = 0; h < n; h++) {
+    // Constant acceleration, but braking vehicles stop rather than reverse
+    const double t_move = (t < stop_time[h]) ? t : stop_time[h];
+    s[h] = s0[h] + v0[h] * t_move + 0.5 * a0[h] * t_move * t_move;
+    speed[h] = v0[h] + a0[h] * t_move;
+    // Minimum-jerk blend from d0 to d1. Clamping t rather than tau keeps
+    // the loop free of a constant path the compiler would branch on.
+    const double t_blend = (t < duration[h]) ? t : duration[h];
+    const double tau = t_blend * inv_duration[h];
+    const double tau3 = tau * tau * tau;
+    d[h] = d0[h] + (d1[h] - d0[h]) * tau3 * (10 - 15 * tau + 6 * tau * tau);
+  }
+}
+
+}  // namespace
+
+PredictionConfig::PredictionConfig()
+    : step(0.02),
+      num_steps(251),
+      lane_change_time(3.0),
+      brake_decel(4.0),
+      brake_prior(0.05),
+      min_weight(0.02) {}
+
+TrajectoryPredictor::TrajectoryPredictor(const LaneGeometry &lanes,
+                                         const PredictionConfig &config)
+    : lanes_(&lanes), config_(config) {
+  vehicle_begin_.push_back(0);
+}
+
+int TrajectoryPredictor::StepAt(double t) const {
+  int step = static_cast<int>(t / config_.step + 0.5);
+  return std::min(std::max(step, 0), config_.num_steps - 1);
+}
+
+void TrajectoryPredictor::AddHypothesis(int vehicle, Maneuver maneuver,
+                                        double weight,
+                                        const VehicleEstimate &estimate) {
+  Hypothesis hypothesis;
+  hypothesis.vehicle = vehicle;
+  hypothesis.maneuver = maneuver;
+  hypothesis.weight = weight;
+  hypotheses_.push_back(hypothesis);
+
+  double accel = estimate.accel_s;
+  if (maneuver == kManeuverBrake) {
+    accel = std::min(accel, -config_.brake_decel);
+  }
+  double speed = std::max(estimate.speed_s, 0.0);
+  s0_.push_back(estimate.s);
+  v0_.push_back(speed);
+  a0_.push_back(accel);
+  stop_time_.push_back(accel < 0 ? speed / -accel
+                                 : std::numeric_limits<double>::infinity());
+
+  // Lateral moves end on a lane center and take lane_change_time per lane
+  // width still to cover.
+  const double lane_width = lanes_->lane_width_at(estimate.s);
+  int lane = static_cast<int>(estimate.d / lane_width);
+  lane = std::min(std::max(lane, 0), lanes_->num_lanes_at(estimate.s) - 1);
+  if (maneuver == kManeuverLeft) {
+    lane--;
+  } else if (maneuver == kManeuverRight) {
+    lane++;
+  }
+  double d1 = estimate.d;
+  if (maneuver == kManeuverLeft || maneuver == kManeuverRight) {
+    d1 = lane_width * (lane + 0.5);
+  }
+  double duration = std::max(config_.lane_change_time *
+                                 std::fabs(d1 - estimate.d) / lane_width,
+                             config_.step);
+  d0_.push_back(estimate.d);
+  d1_.push_back(d1);
+  duration_.push_back(duration);
+  inv_duration_.push_back(1.0 / duration);
+}
+
+void TrajectoryPredictor::Predict(
+    const std::vector<VehicleEstimate> &vehicles) {
+  hypotheses_.clear();
+  vehicle_begin_.clear();
+  s0_.clear();
+  v0_.clear();
+  a0_.clear();
+  stop_time_.clear();
+  d0_.clear();
+  d1_.clear();
+  duration_.clear();
+  inv_duration_.clear();
+
+  for (int v = 0; v < static_cast<int>(vehicles.size()); v++) {
+    const VehicleEstimate &estimate = vehicles[v];
+    vehicle_begin_.push_back(num_hypotheses());
+
+    // Braking takes its share from keeping the lane, more so for a vehicle
+    // that is already slowing down.
+    double braking = std::min(std::max(-estimate.accel_s, 0.0) /
+                                  config_.brake_decel,
+                              1.0);
+    double p_brake =
+        config_.brake_prior + (1 - config_.brake_prior) * braking;
+    double weights[kNumManeuvers];
+    weights[kManeuverKeep] = estimate.p_keep * (1 - p_brake);
+    weights[kManeuverLeft] = estimate.p_left;
+    weights[kManeuverRight] = estimate.p_right;
+    weights[kManeuverBrake] = estimate.p_keep * p_brake;
+
+    double total = 0;
+    for (int m = 0; m < kNumManeuvers; m++) {
+      if (weights[m] < config_.min_weight) {
+        weights[m] = 0;
+      }
+      total += weights[m];
+    }
+    if (total <= 0) {
+      weights[kManeuverKeep] = total = 1;
+    }
+    for (int m = 0; m < kNumManeuvers; m++) {
+      if (weights[m] > 0) {
+        AddHypothesis(v, static_cast<Maneuver>(m), weights[m] / total,
+                      estimate);
+      }
+    }
+  }
+  vehicle_begin_.push_back(num_hypotheses());
+
+  const int n = num_hypotheses();
+  s_.resize(config_.num_steps * n);
+  d_.resize(config_.num_steps * n);
+  speed_.resize(config_.num_steps * n);
+
+  for (int k = 0; k < config_.num_steps; k++) {
+    SampleStep(n, k * config_.step, s0_.data(), v0_.data(), a0_.data(),
+               stop_time_.data(), d0_.data(), d1_.data(), duration_.data(),
+               inv_duration_.data(), s_.data() + k * n, d_.data() + k * n,
+               speed_.data() + k * n);
+  }
+}
@@ -0,0 +1,116 @@
+#ifndef PREDICTION_H_
+#define PREDICTION_H_
+
+#include <vector>
+
+#include "lane_geometry.h"
+
+// Futures considered for every other vehicle.
+enum Maneuver {
+  kManeuverKeep,
+  kManeuverLeft,
+  kManeuverRight,
+  kManeuverBrake,
+  kNumManeuvers
+};
+
+// Current estimate of a vehicle, the input of the prediction.
+struct VehicleEstimate {
+  double s;
+  double d;
+  double speed_s;  // m/s along the road
+  double accel_s;  // m/s^2 along the road
+  // Lane-change intent probabilities.
+  double p_keep;
+  double p_left;
+  double p_right;
+};
+
+struct PredictionConfig {
+  PredictionConfig();
+
+  // Sampling of the trajectories: num_steps samples `step` seconds apart,
+  // the first at t = 0.
+  double step;
+  int num_steps;
+  // Time to move one full lane width across.
+  double lane_change_time;
+  // Deceleration of the braking hypothesis, m/s^2.
+  double brake_decel;
+  // Share of the keep-lane probability given to braking for a vehicle that
+  // is not decelerating; grows to all of it at brake_decel.
+  double brake_prior;
+  // Hypotheses less likely than this are dropped.
+  double min_weight;
+};
+
+// One predicted future of one vehicle.
+struct Hypothesis {
+  int vehicle;     // index into the Predict() input
+  Maneuver maneuver;
+  double weight;   // the weights of a vehicle sum to 1
+};
+
+// Multi-hypothesis prediction of the other vehicles. For every vehicle it
+// builds a few weighted futures (keep the lane, change left or right,
+// brake) and samples them at a fixed time step.
+//
+// Samples are stored time-major, one array per quantity: all hypotheses at
+// step 0, then all at step 1 and so on, so a collision check walking
+// forward in time streams through memory. Hypotheses of the same vehicle
+// are adjacent.
+class TrajectoryPredictor {
+ public:
+  // Lane changes end on the lanes of `lanes`, which must outlive the
+  // predictor.
+  TrajectoryPredictor(const LaneGeometry &lanes,
+                      const PredictionConfig &config);
+
+  void Predict(const std::vector<VehicleEstimate> &vehicles);
+
+  int num_hypotheses() const { return static_cast<int>(hypotheses_.size()); }
+  const Hypothesis &hypothesis(int h) const { return hypotheses_[h]; }
+  // Hypotheses of vehicle v are [vehicle_begin(v), vehicle_begin(v + 1)).
+  int num_vehicles() const {
+    return static_cast<int>(vehicle_begin_.size()) - 1;
+  }
+  int vehicle_begin(int v) const { return vehicle_begin_[v]; }
+
+  double step() const { return config_.step; }
+  int num_steps() const { return config_.num_steps; }
+  // Step closest to t seconds, clamped to the sampled horizon.
+  int StepAt(double t) const;
+
+  // s, d and speed along the road of every hypothesis at a step; arrays of
+  // num_hypotheses() entries.
+  const double *s_at(int step) const {
+    return s_.data() + step * num_hypotheses();
+  }
+  const double *d_at(int step) const {
+    return d_.data() + step * num_hypotheses();
+  }
+  const double *speed_at(int step) const {
+    return speed_.data() + step * num_hypotheses();
+  }
+
+ private:
+  void AddHypothesis(int vehicle, Maneuver maneuver, double weight,
+                     const VehicleEstimate &estimate);
+
+  const LaneGeometry *lanes_;
+  PredictionConfig config_;
+
+  std::vector<Hypothesis> hypotheses_;
+  std::vector<int> vehicle_begin_;
+
+  // Motion parameters per hypothesis.
+  std::vector<double> s0_, v0_, a0_;
+  std::vector<double> stop_time_;    // when braking reaches standstill
+  std::vector<double> d0_, d1_;      // start and end of the lateral move
+  std::vector<double> duration_, inv_duration_;
+
+  // Samples, num_steps x num_hypotheses.
+  std::vector<double> s_, d_, speed_;
+};
+
+#endif  // PREDICTION_H_
@@ -0,0 +1,49 @@
+#include "speed_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+SpeedProfileConfig::SpeedProfileConfig()
+    : max_accel(5.0), max_decel(6.0), max_jerk(6.0) {}
+
+SpeedProfile::SpeedProfile(const SpeedProfileConfig &config, double speed)
+    : config_(config), following_(config.following), target_(speed),
+      limit_(std::numeric_limits<double>::infinity()), has_lead_(false),
+      lead_distance_(0), lead_speed_(0), speed_(speed), accel_(0) {}
+
+void SpeedProfile::set_lead(double distance, double lead_speed) {
+  has_lead_ = true;
+  lead_distance_ = distance;
+  lead_speed_ = lead_speed;
+}
+
+double SpeedProfile::Step(double dt) {
+  // Ramping an acceleration a down to zero at max_jerk changes the speed by
+  // a^2 / (2 max_jerk), so the largest acceleration that still stops at the
+  // target is sqrt(2 max_jerk |error|).
+  const double error = std::min(target_, limit_) - speed_;
+  double wanted = std::sqrt(2 * config_.max_jerk * std::fabs(error));
+  wanted = (error >= 0) ? std::min(wanted, config_.max_accel)
+                        : -std::min(wanted, config_.max_decel);
+  if (has_lead_) {
+    wanted = std::max(-config_.max_decel,
+                      std::min(wanted, following_.GapAccel(
+                                           speed_, lead_distance_,
+                                           lead_speed_)));
+  }
+
+  const double max_change = config_.max_jerk * dt;
+  const double accel =
+      accel_ + std::max(-max_change, std::min(max_change, wanted - accel_));
+  const double old_speed = speed_;
+  speed_ = speed_ + (accel_ + accel) / 2 * dt;
+  accel_ = accel;
+  // Stopped; braking does not make us reverse.
+  if (speed_ <= 0) {
+    speed_ = 0;
+    accel_ = std::max(accel_, 0.0);
+  }
+  lead_distance_ += (lead_speed_ - (old_speed + speed_) / 2) * dt;
+  return speed_;
+}
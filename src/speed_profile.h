@@ -0,0 +1,69 @@
+#ifndef SPEED_PROFILE_H_
+#define SPEED_PROFILE_H_
+
+#include "car_following.h"
+
+struct SpeedProfileConfig {
+  SpeedProfileConfig();
+
+  double max_accel;  // m/s^2
+  double max_decel;  // m/s^2, positive
+  double max_jerk;   // m/s^3
+  CarFollowingConfig following;
+};
+
+// Longitudinal speed plan along the path, advanced one output point at a
+// time. The acceleration moves towards the target speed in an S-curve:
+// it ramps up and down at no more than max_jerk, stays within the
+// acceleration limits, and starts to ramp down early enough to arrive at
+// the target speed with zero acceleration instead of overshooting.
+//
+// With a car in front, the acceleration is also capped by the gap term of
+// the car-following model, so the profile closes up smoothly and then
+// holds the gap instead of alternating between braking and accelerating.
+// The car in front is assumed to keep its speed while the points of one
+// tick are produced.
+//
+// The state is the speed and acceleration at the last point produced, which
+// is the end of the path sent to the simulator, so it carries over from
+// one tick to the next.
+class SpeedProfile {
+ public:
+  SpeedProfile(const SpeedProfileConfig &config, double speed);
+
+  void set_target(double speed) { target_ = speed; }
+  double target() const { return target_; }
+  // Upper bound on the target, e.g. for a curve ahead; kept until changed.
+  void set_limit(double speed) { limit_ = speed; }
+  double limit() const { return limit_; }
+  // Car in front, `distance` metres ahead of the last point (center to
+  // center) at lead_speed m/s.
+  void set_lead(double distance, double lead_speed);
+  void clear_lead() { has_lead_ = false; }
+  bool has_lead() const { return has_lead_; }
+
+  // Restarts from an earlier point of the path.
+  void Reset(double speed, double accel) {
+    speed_ = speed;
+    accel_ = accel;
+  }
+
+  // Advances by dt seconds and returns the speed at the end.
+  double Step(double dt);
+
+  double speed() const { return speed_; }
+  double accel() const { return accel_; }
+
+ private:
+  SpeedProfileConfig config_;
+  CarFollowing following_;
+  double target_;
+  double limit_;
+  bool has_lead_;
+  double lead_distance_;
+  double lead_speed_;
+  double speed_;
+  double accel_;
+};
+
+#endif  // SPEED_PROFILE_H_
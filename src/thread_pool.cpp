@@ -0,0 +1,183 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// Rounds of stealing attempts before an idle worker goes to sleep. Each
+// round yields, so this amounts to a few tens of microseconds.
+const int kSpinRounds = 256;
+
+// Queue of the calling thread in the pool it last worked for: its own for
+// pool workers, a claimed caller queue for threads calling ParallelFor.
+thread_local const ThreadPool *tls_pool = nullptr;
+thread_local int tls_index = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(int num_threads, bool pin_threads, int num_callers)
+    : num_callers_(std::max(1, num_callers)), next_caller_(0), stop_(false),
+      queued_(0), sleeping_(0), num_steals_(0) {
+  num_threads = std::max(1, num_threads);
+  for (int i = 0; i < num_callers_ + num_threads - 1; i++) {
+    queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+
+  int num_cpus = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < num_threads; i++) {
+    int cpu = pin_threads ? i % num_cpus : -1;
+    threads_.push_back(std::thread(&ThreadPool::WorkerLoop, this,
+                                   num_callers_ + i - 1, cpu));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  sleep_cv_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::ParallelFor(int begin, int end,
+                             const std::function<void(int)> &fn, int grain) {
+  if (begin >= end) {
+    return;
+  }
+  if (threads_.empty()) {
+    for (int i = begin; i < end; i++) {
+      fn(i);
+    }
+    return;
+  }
+
+  int self = Self();
+
+  Job job;
+  job.fn = &fn;
+  job.grain = std::max(1, grain);
+  job.pending = end - begin;
+
+  Task task;
+  task.job = &job;
+  task.begin = begin;
+  task.end = end;
+  Run(self, task);
+
+  // Join: help with our own job until it has drained. Only its pieces are
+  // taken, so one caller's join never runs another caller's job.
+  while (job.pending > 0) {
+    if (Pop(self, &task, &job) || Steal(self, &task, &job)) {
+      Run(self, task);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
+
+int ThreadPool::Self() {
+  if (tls_pool != this) {
+    tls_pool = this;
+    tls_index = next_caller_++ % num_callers_;
+  }
+  return tls_index;
+}
+
+void ThreadPool::Push(int self, const Task &task) {
+  {
+    std::lock_guard<std::mutex> lock(queues_[self]->mutex);
+    queues_[self]->tasks.push_back(task);
+  }
+  queued_++;
+  if (sleeping_ > 0) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_all();
+  }
+}
+
+bool ThreadPool::Pop(int self, Task *task, const Job *job) {
+  Queue &queue = *queues_[self];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty() || (job && queue.tasks.back().job != job)) {
+    return false;
+  }
+  *task = queue.tasks.back();
+  queue.tasks.pop_back();
+  queued_--;
+  return true;
+}
+
+bool ThreadPool::Steal(int self, Task *task, const Job *job) {
+  int n = static_cast<int>(queues_.size());
+  for (int k = 1; k < n; k++) {
+    Queue &queue = *queues_[(self + k) % n];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty() && (!job || queue.tasks.front().job == job)) {
+      *task = queue.tasks.front();
+      queue.tasks.pop_front();
+      queued_--;
+      num_steals_++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Run(int self, Task task) {
+  while (task.end - task.begin > task.job->grain) {
+    int mid = task.begin + (task.end - task.begin) / 2;
+    Task upper = task;
+    upper.begin = mid;
+    Push(self, upper);
+    task.end = mid;
+  }
+
+  const std::function<void(int)> &fn = *task.job->fn;
+  for (int i = task.begin; i < task.end; i++) {
+    fn(i);
+  }
+  // The job lives on the stack of the thread that forked it; it may be gone
+  // as soon as pending reaches zero, so nothing touches it afterwards.
+  task.job->pending -= task.end - task.begin;
+}
+
+void ThreadPool::WorkerLoop(int self, int cpu) {
+  tls_pool = this;
+  tls_index = self;
+
+#ifdef __linux__
+  if (cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#else
+  (void)cpu;
+#endif
+
+  Task task;
+  int idle_rounds = 0;
+  while (!stop_) {
+    if (Pop(self, &task) || Steal(self, &task)) {
+      Run(self, task);
+      idle_rounds = 0;
+    } else if (++idle_rounds < kSpinRounds) {
+      std::this_thread::yield();
+    } else {
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      sleeping_++;
+      sleep_cv_.wait(lock, [this] { return stop_ || queued_ > 0; });
+      sleeping_--;
+      idle_rounds = 0;
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool of worker threads used to spread per-tick planner work
+// (candidate evaluation, prediction) over the available cores.
+//
+// Every participant owns a deque of index ranges. A participant splits the
+// range it is working on in halves, pushes the upper half to the back of its
+// own deque and keeps going with the lower half; idle participants steal from
+// the front of other deques, so they take the largest pieces. Workers spin
+// briefly before sleeping, which keeps fork/join latency in the microsecond
+// range for the sub-millisecond jobs issued every simulator tick.
+class ThreadPool {
+ public:
+  // Starts num_threads - 1 workers; the thread calling ParallelFor is the
+  // last participant, so a pool of size 1 runs everything inline. With
+  // pin_threads each worker is bound to one CPU (Linux only).
+  //
+  // Up to num_callers threads outside the pool can call ParallelFor at the
+  // same time with a deque of their own; each claims one on its first
+  // call. While joining, a caller only runs pieces of its own job, so a
+  // slow job of one caller never holds up another. Further callers share
+  // those deques round-robin.
+  explicit ThreadPool(int num_threads, bool pin_threads = false,
+                      int num_callers = 1);
+  ~ThreadPool();
+
+  // Calls fn(i) for every i in [begin, end) and returns once all calls are
+  // done. Ranges are not split below grain indices.
+  void ParallelFor(int begin, int end, const std::function<void(int)> &fn,
+                   int grain = 1);
+
+  int size() const { return static_cast<int>(threads_.size()) + 1; }
+
+  // Number of ranges taken from another participant's deque so far.
+  long num_steals() const { return num_steals_; }
+
+ private:
+  struct Job {
+    const std::function<void(int)> *fn;
+    int grain;
+    std::atomic<int> pending;
+  };
+
+  struct Task {
+    Job *job;
+    int begin;
+    int end;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Pop() and Steal() take any task, or with a job only that job's.
+  void Push(int self, const Task &task);
+  bool Pop(int self, Task *task, const Job *job = nullptr);
+  bool Steal(int self, Task *task, const Job *job = nullptr);
+  // Splits the task down to its grain, exposing the upper halves to
+  // thieves, then runs what is left.
+  void Run(int self, Task task);
+  void WorkerLoop(int self, int cpu);
+  // Deque of the calling thread, claiming a caller deque if it has none.
+  int Self();
+
+  // The first num_callers_ queues belong to threads calling ParallelFor,
+  // queues_[num_callers_ + i] to threads_[i].
+  std::vector<std::unique_ptr<Queue>> queues_;
+  int num_callers_;
+  std::atomic<int> next_caller_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> stop_;
+  std::atomic<int> queued_;
+  std::atomic<int> sleeping_;
+  std::atomic<long> num_steals_;
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+};
+
+#endif  // THREAD_POOL_H_
@@ -0,0 +1,117 @@
+#include "tracker.h"
+
+#include <algorithm>
+
+namespace {
+
+unsigned Hash(int id) { return static_cast<unsigned>(id) * 2654435761u; }
+
+}  // namespace
+
+Tracker::Tracker(int max_tracks) : time_(0), tick_(0) {
+  tracks_.resize(max_tracks);
+  for (int i = max_tracks - 1; i >= 0; i--) {
+    free_.push_back(i);
+  }
+  live_.reserve(max_tracks);
+  stale_.reserve(max_tracks);
+
+  // Keep the load factor at or below one half.
+  unsigned table_size = 1;
+  while (table_size < 2u * max_tracks) {
+    table_size <<= 1;
+  }
+  keys_.assign(table_size, -1);
+  values_.assign(table_size, -1);
+  mask_ = table_size - 1;
+}
+
+int Tracker::Slot(int id) const {
+  unsigned slot = Hash(id) & mask_;
+  while (keys_[slot] != -1 && keys_[slot] != id) {
+    slot = (slot + 1) & mask_;
+  }
+  return static_cast<int>(slot);
+}
+
+int Tracker::Find(int id) const {
+  int slot = Slot(id);
+  return keys_[slot] == id ? values_[slot] : -1;
+}
+
+void Tracker::BeginTick(double time) {
+  time_ = time;
+  tick_++;
+}
+
+int Tracker::Observe(int id) {
+  int slot = Slot(id);
+  int index;
+  if (keys_[slot] == id) {
+    index = values_[slot];
+  } else {
+    if (free_.empty()) {
+      return -1;
+    }
+    index = free_.back();
+    free_.pop_back();
+    live_.push_back(index);
+    keys_[slot] = id;
+    values_[slot] = index;
+
+    Track &track = tracks_[index];
+    track.id = id;
+    track.num_samples = 0;
+  }
+
+  Track &track = tracks_[index];
+  // Several ticks can arrive before the simulator advances; count one
+  // sample per point in time.
+  if (track.num_samples == 0 || track.last_time < time_) {
+    track.num_samples++;
+  }
+  track.last_time = time_;
+  track.last_tick = tick_;
+  return index;
+}
+
+void Tracker::EndTick() {
+  stale_.clear();
+  for (int index : live_) {
+    if (tick_ - tracks_[index].last_tick > kMaxMissedTicks) {
+      stale_.push_back(index);
+    }
+  }
+  for (int index : stale_) {
+    Erase(tracks_[index].id);
+    live_.erase(std::find(live_.begin(), live_.end(), index));
+    free_.push_back(index);
+  }
+}
+
+void Tracker::Erase(int id) {
+  unsigned hole = static_cast<unsigned>(Slot(id));
+  if (keys_[hole] != id) {
+    return;
+  }
+  keys_[hole] = -1;
+
+  // Backward-shift deletion: pull later entries of the probe chain into the
+  // hole unless their home slot lies between the hole and where they are.
+  unsigned slot = hole;
+  while (true) {
+    slot = (slot + 1) & mask_;
+    if (keys_[slot] == -1) {
+      return;
+    }
+    unsigned home = Hash(keys_[slot]) & mask_;
+    bool stays = (hole <= slot) ? (hole < home && home <= slot)
+                                : (hole < home || home <= slot);
+    if (!stays) {
+      keys_[hole] = keys_[slot];
+      values_[hole] = values_[slot];
+      keys_[slot] = -1;
+      hole = slot;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef TRACKER_H_
+#define TRACKER_H_
+
+#include <vector>
+
+// What we know about one vehicle across ticks. Its state estimate lives in
+// the Kalman filter bank under the same index.
+struct Track {
+  int id;           // sensor fusion id
+  int last_tick;    // tick of the latest observation
+  double last_time; // s, session clock of the latest observation
+  int num_samples;  // distinct points in time the vehicle was seen at
+};
+
+// Keeps a track per sensor fusion vehicle id across ticks. Tracks live in a
+// fixed pool and are found through a flat open-addressing hash table, so
+// updating with a tick's sensor fusion data does not allocate.
+//
+// Usage per tick: BeginTick(), Observe() for every vehicle, EndTick().
+class Tracker {
+ public:
+  // Ticks a vehicle may go unseen before its track is dropped.
+  static const int kMaxMissedTicks = 10;
+
+  explicit Tracker(int max_tracks = 128);
+
+  void BeginTick(double time);
+  // Marks the vehicle as seen, creating its track if needed. Returns the
+  // track index, or -1 if the pool is full.
+  int Observe(int id);
+  // Drops the tracks of vehicles that have not been seen for a while.
+  void EndTick();
+
+  // Track index for a vehicle id, or -1.
+  int Find(int id) const;
+  const Track &track(int index) const { return tracks_[index]; }
+  // Indices of all live tracks.
+  const std::vector<int> &live() const { return live_; }
+  int max_tracks() const { return static_cast<int>(tracks_.size()); }
+  // Current tick; tracks observed in it have last_tick == tick().
+  int tick() const { return tick_; }
+
+ private:
+  int Slot(int id) const;
+  void Erase(int id);
+
+  double time_;
+  int tick_;
+
+  std::vector<Track> tracks_;
+  std::vector<int> free_;       // unused track indices
+  std::vector<int> live_;       // used track indices
+  std::vector<int> stale_;      // scratch for EndTick()
+
+  // Hash table from id to track index; keys_[i] == -1 marks an empty slot.
+  std::vector<int> keys_;
+  std::vector<int> values_;
+  unsigned mask_;
+};
+
+#endif  // TRACKER_H_
@@ -0,0 +1,81 @@
+// Checks of the previous path bookkeeping.
+//
+//   ./path_reuse_test
+
+#include <iostream>
+
+#include "path_reuse.h"
+
+using namespace std;
+
+namespace {
+
+int num_failures = 0;
+
+void Expect(bool ok, const char *what) {
+  if (!ok) {
+    cerr << "FAILED: " << what << endl;
+    num_failures++;
+  }
+}
+
+// A previous path of n points, all known to the path reuse.
+PathReuse Sent(const PathReuseConfig &config, int n) {
+  PathReuse reuse(config);
+  for (int i = 0; i < n; i++) {
+    reuse.Add(20, 0);
+  }
+  return reuse;
+}
+
+void TestHazardCutsPath() {
+  PathReuseConfig config;
+  PathReuse reuse = Sent(config, 40);
+  int keep = reuse.Keep(40, true);
+  reuse.Truncate(40, keep);
+  Expect(keep == config.hazard_keep, "hazard keeps hazard_keep points");
+  Expect(reuse.size() == keep, "truncated to the kept points");
+  Expect(reuse.num_truncations() == 1, "cut counts as a truncation");
+}
+
+void TestShortPathIsNotTruncation() {
+  // Fewer points left than a hazard keeps: nothing is dropped.
+  PathReuseConfig config;
+  PathReuse reuse = Sent(config, config.hazard_keep);
+  int keep = reuse.Keep(config.hazard_keep, true);
+  reuse.Truncate(config.hazard_keep, keep);
+  Expect(keep == config.hazard_keep, "short path is kept whole");
+  Expect(reuse.num_truncations() == 0, "short path is no truncation");
+
+  // Below the two points the path continues from.
+  reuse = Sent(config, 1);
+  keep = reuse.Keep(1, true);
+  reuse.Truncate(1, keep);
+  Expect(keep == 1, "single point is kept");
+  Expect(reuse.num_truncations() == 0, "single point is no truncation");
+}
+
+void TestResyncIsNotTruncation() {
+  // More points remembered than the simulator still has, e.g. after a
+  // reconnect: the extra ones are forgotten without counting.
+  PathReuseConfig config;
+  PathReuse reuse = Sent(config, 30);
+  int keep = reuse.Keep(20, false);
+  reuse.Truncate(20, keep);
+  Expect(keep == 20, "mismatched path is kept whole");
+  Expect(reuse.size() == 20, "extra points are forgotten");
+  Expect(reuse.num_truncations() == 0, "resync is no truncation");
+}
+
+}  // namespace
+
+int main() {
+  TestHazardCutsPath();
+  TestShortPathIsNotTruncation();
+  TestResyncIsNotTruncation();
+  if (num_failures > 0) {
+    return 1;
+  }
+  cout << "path reuse: all checks passed" << endl;
+  return 0;
+}